@@ -0,0 +1,200 @@
+/**
+ * @file AsyncChip8.cpp
+ * @brief Coroutine interface that suspends a machine waiting for input instead of spinning it.
+ * 
+ */
+
+#include "AsyncChip8.hpp"
+
+Chip8Task::Chip8Task(std::coroutine_handle<promise_type> coroutine)
+        : coroutine(coroutine)
+{
+}
+
+Chip8Task::Chip8Task(Chip8Task&& other) noexcept
+        : coroutine(other.coroutine)
+{
+    other.coroutine = nullptr;
+}
+
+Chip8Task& Chip8Task::operator=(Chip8Task&& other) noexcept
+{
+    if (this != &other)
+    {
+        Destroy();
+        coroutine = other.coroutine;
+        other.coroutine = nullptr;
+    }
+    return *this;
+}
+
+Chip8Task::~Chip8Task()
+{
+    Destroy();
+}
+
+bool Chip8Task::Done() const
+{
+    return !coroutine || coroutine.done();
+}
+
+/**
+ * @brief Destroy the coroutine's frame, whether or not it has finished.
+ * A coroutine suspended on a session is taken off it first, so PressKey won't resume the freed frame.
+ * 
+ */
+void Chip8Task::Destroy()
+{
+    if (coroutine)
+    {
+        if (coroutine.promise().waitingOn)
+        {
+            *coroutine.promise().waitingOn = nullptr;
+        }
+        coroutine.destroy();
+    }
+}
+
+/**
+ * @brief Attach a session to a machine.
+ * 
+ * @param chip machine to run
+ * @param clockRate instructions per second, which sets how many instructions make up a frame
+ */
+template <typename Machine>
+BasicAsyncChip8<Machine>::BasicAsyncChip8(Machine& chip, uint32_t clockRate)
+        : chip(chip), scheduler(chip, clockRate, SchedulerMode::Unthrottled)
+{
+}
+
+/**
+ * @brief Detach the session from the task waiting on it, if any, so destroying the task later
+ * doesn't touch the session.
+ * 
+ */
+template <typename Machine>
+BasicAsyncChip8<Machine>::~BasicAsyncChip8()
+{
+    if (waiter)
+    {
+        waiter.promise().waitingOn = nullptr;
+    }
+}
+
+template <typename Machine>
+typename BasicAsyncChip8<Machine>::FrameAwaiter BasicAsyncChip8<Machine>::RunUntilFrame()
+{
+    return FrameAwaiter{*this};
+}
+
+template <typename Machine>
+typename BasicAsyncChip8<Machine>::KeyAwaiter BasicAsyncChip8<Machine>::WaitKey()
+{
+    return KeyAwaiter{*this};
+}
+
+/**
+ * @brief Press a key and resume the coroutine waiting on the session, through the resumer if one is set.
+ * 
+ * @param key key 0 through F
+ * @effects chip.keypad by setting the key down
+ */
+template <typename Machine>
+void BasicAsyncChip8<Machine>::PressKey(uint8_t key)
+{
+    chip.keypad[key & 0x0FU] = 1;
+
+    if (waiter)
+    {
+        std::coroutine_handle<> coroutine = waiter;
+        waiter.promise().waitingOn = nullptr;
+        waiter = nullptr;
+        if (resumer)
+        {
+            resumer(coroutine, resumerContext);
+        } else
+        {
+            coroutine.resume();
+        }
+    }
+}
+
+template <typename Machine>
+void BasicAsyncChip8<Machine>::ReleaseKey(uint8_t key)
+{
+    chip.keypad[key & 0x0FU] = 0;
+}
+
+template <typename Machine>
+void BasicAsyncChip8<Machine>::SetResumer(ResumeFunction function, void* context)
+{
+    resumer = function;
+    resumerContext = context;
+}
+
+/**
+ * @brief Whether running a frame would change nothing but the instruction count:
+ * the machine waits in FX0A with no key down and has no timer left to count down.
+ * 
+ * @return true if the machine can only move on after a key press
+ */
+template <typename Machine>
+bool BasicAsyncChip8<Machine>::Blocked() const
+{
+    return chip.timer == 0 && chip.soundTimer == 0 && chip.DetectIdle() == IdleState::WaitingForKey;
+}
+
+template <typename Machine>
+bool BasicAsyncChip8<Machine>::Suspended() const
+{
+    return static_cast<bool>(waiter);
+}
+
+template <typename Machine>
+BasicScheduler<Machine>& BasicAsyncChip8<Machine>::Clock()
+{
+    return scheduler;
+}
+
+/**
+ * @brief Make a coroutine the one waiting on the session, linking it both ways so either can go first.
+ * 
+ * @param coroutine task suspending in RunUntilFrame or WaitKey
+ */
+template <typename Machine>
+void BasicAsyncChip8<Machine>::Suspend(std::coroutine_handle<Chip8Task::promise_type> coroutine)
+{
+    waiter = coroutine;
+    coroutine.promise().waitingOn = &waiter;
+}
+
+template <typename Machine>
+bool BasicAsyncChip8<Machine>::KeyDown() const
+{
+    for (uint8_t key = 0; key < 16; key++)
+    {
+        if (chip.keypad[key])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Machine>
+uint8_t BasicAsyncChip8<Machine>::LowestKeyDown() const
+{
+    for (uint8_t key = 0; key < 16; key++)
+    {
+        if (chip.keypad[key])
+        {
+            return key;
+        }
+    }
+    return 0;
+}
+
+template class BasicAsyncChip8<Chip8>;
+template class BasicAsyncChip8<CosmacChip8>;
+template class BasicAsyncChip8<SuperChip8>;
+template class BasicAsyncChip8<XoChip8>;
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Scheduler.hpp"
+#include <coroutine>
+#include <exception>
+
+// Coroutine type for host code that co_awaits a BasicAsyncChip8. It starts running as soon as it is
+// called and keeps its frame until destroyed, so the host can poll Done() after each resumption.
+// Destroying a task that is suspended on a session detaches it from the session first.
+class Chip8Task
+{
+public:
+    struct promise_type
+    {
+        Chip8Task get_return_object()
+        {
+            return Chip8Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        std::coroutine_handle<promise_type>* waitingOn = nullptr; //waiter of the session it is suspended on
+    };
+
+    Chip8Task(Chip8Task&& other) noexcept;
+    Chip8Task& operator=(Chip8Task&& other) noexcept;
+    ~Chip8Task();
+
+    bool Done() const; //the coroutine has returned
+
+private:
+    explicit Chip8Task(std::coroutine_handle<promise_type> coroutine);
+    void Destroy();
+
+    std::coroutine_handle<promise_type> coroutine;
+};
+
+// Resumes a coroutine that was waiting for input, e.g. by posting it to the host's event loop
+typedef void (*ResumeFunction)(std::coroutine_handle<> coroutine, void* context);
+
+// Coroutine interface to a machine for hosts built on an event loop. co_await RunUntilFrame() runs one
+// frame through a BasicScheduler, and co_await WaitKey() waits for a key. While the machine sits in
+// FX0A with both timers stopped, a frame could change nothing, so RunUntilFrame suspends the coroutine instead
+// of spinning; PressKey resumes it. A suspended session holds no thread and costs nothing, and its
+// instruction count stands still until it resumes.
+// Only one coroutine may wait on a session at a time, and PressKey and ReleaseKey must be called
+// on the thread that runs it. A task destroyed while it waits, as when its user disconnects in FX0A,
+// leaves the session with nothing to resume; a coroutine already handed to the resumer is the host's
+// to drop along with the task. Machine is any Chip8Core variant.
+template <typename Machine>
+class BasicAsyncChip8
+{
+public:
+    struct FrameAwaiter
+    {
+        BasicAsyncChip8& session;
+
+        bool await_ready() const { return !session.Blocked(); }
+        void await_suspend(std::coroutine_handle<Chip8Task::promise_type> coroutine) { session.Suspend(coroutine); }
+        void await_resume() { session.scheduler.RunFrame(); }
+    };
+
+    struct KeyAwaiter
+    {
+        BasicAsyncChip8& session;
+
+        bool await_ready() const { return session.KeyDown(); }
+        void await_suspend(std::coroutine_handle<Chip8Task::promise_type> coroutine) { session.Suspend(coroutine); }
+        uint8_t await_resume() const { return session.LowestKeyDown(); }
+    };
+
+    explicit BasicAsyncChip8(Machine& chip, uint32_t clockRate = 700);
+    BasicAsyncChip8(BasicAsyncChip8 const&) = delete;
+    BasicAsyncChip8& operator=(BasicAsyncChip8 const&) = delete;
+    ~BasicAsyncChip8(); //detaches the waiting task, which can then only be destroyed
+
+    FrameAwaiter RunUntilFrame(); //co_await runs one frame, suspending first while the machine is blocked
+    KeyAwaiter WaitKey(); //co_await suspends until a key is down, then gives the lowest key down
+
+    void PressKey(uint8_t key); //resumes the waiting coroutine, if any
+    void ReleaseKey(uint8_t key);
+    void SetResumer(ResumeFunction resumer, void* context); //nullptr resumes inside PressKey
+
+    bool Blocked() const; //in FX0A with no key down and both timers at zero
+    bool Suspended() const; //a coroutine is waiting on this session
+    BasicScheduler<Machine>& Clock(); //clock rate, timer ticks, runner and frame publishing
+
+private:
+    Machine& chip;
+    BasicScheduler<Machine> scheduler;
+    std::coroutine_handle<Chip8Task::promise_type> waiter;
+    ResumeFunction resumer = nullptr;
+    void* resumerContext = nullptr;
+
+    void Suspend(std::coroutine_handle<Chip8Task::promise_type> coroutine);
+    bool KeyDown() const;
+    uint8_t LowestKeyDown() const;
+};
+
+typedef BasicAsyncChip8<Chip8> AsyncChip8;
+
+extern template class BasicAsyncChip8<Chip8>;
+extern template class BasicAsyncChip8<CosmacChip8>;
+extern template class BasicAsyncChip8<SuperChip8>;
+extern template class BasicAsyncChip8<XoChip8>;
@@ -0,0 +1,127 @@
+/**
+ * @file Beeper.cpp
+ * @brief Square wave beeper rendered on the audio thread from sound timer edges.
+ * 
+ */
+
+#include "Beeper.hpp"
+#include <algorithm>
+#include <cmath>
+
+const double FRAMES_PER_SECOND = 60.0; //scheduler frames, the longest gap between publishes
+
+Beeper::Beeper(BeeperSettings const& settings)
+        : settings(settings)
+{
+    cyclesPerSample = static_cast<double>(settings.clockRate) / settings.sampleRate;
+    latencyCycles = settings.latencySamples * cyclesPerSample;
+    slackCycles = latencyCycles + settings.clockRate / FRAMES_PER_SECOND;
+}
+
+/**
+ * @brief Fill an audio buffer, following the beeper edges queued so far.
+ * Samples are silent until the emulator has published a cycle.
+ * 
+ * @param samples destination, mono
+ * @param count number of samples, whatever the audio API asks for
+ */
+void Beeper::Render(float* samples, size_t count)
+{
+    if (!published.load(std::memory_order_acquire))
+    {
+        std::fill(samples, samples + count, 0.0F);
+        return;
+    }
+
+    //Stay latencyCycles behind the emulator, jumping if it stalled or raced ahead
+    double target = static_cast<double>(publishedCycle.load(std::memory_order_acquire)) - latencyCycles;
+    if (!synced || std::abs(playCycle - target) > slackCycles)
+    {
+        playCycle = target;
+        synced = true;
+    }
+
+    const float step = settings.frequency / settings.sampleRate;
+    size_t done = 0;
+    while (done < count)
+    {
+        //Apply every edge up to the next sample
+        while (hasPending || (hasPending = edges.Pop(pending)))
+        {
+            if (static_cast<double>(pending.cycle) > playCycle)
+            {
+                break;
+            }
+            on = pending.on;
+            hasPending = false;
+        }
+
+        //Samples before the next edge all take the same state
+        size_t run = count - done;
+        if (hasPending)
+        {
+            double untilEdge = std::ceil((static_cast<double>(pending.cycle) - playCycle) / cyclesPerSample);
+            if (untilEdge < static_cast<double>(run))
+            {
+                run = static_cast<size_t>(untilEdge);
+            }
+        }
+
+        if (on)
+        {
+            for (size_t i = 0; i < run; i++)
+            {
+                samples[done + i] = phase < 0.5F ? settings.volume : -settings.volume;
+                phase += step;
+                phase -= phase >= 1.0F ? 1.0F : 0.0F;
+            }
+        } else
+        {
+            std::fill(samples + done, samples + done + run, 0.0F);
+            phase = 0.0F; //every beep starts on the same edge of the wave
+        }
+
+        done += run;
+        playCycle += run * cyclesPerSample;
+    }
+}
+
+bool Beeper::On() const
+{
+    return on;
+}
+
+/**
+ * @brief Queue an edge for the audio thread.
+ * 
+ * @param edge beeper change and the cycle it happened on
+ * @effects edgesDropped by incrementing if the queue is full
+ */
+void Beeper::PushEdge(BeepEdge const& edge)
+{
+    if (!edges.Push(edge))
+    {
+        edgesDropped++;
+    }
+}
+
+/**
+ * @brief Tell the audio thread the machine has run up to a cycle, so it may play up to latencyCycles before it.
+ * 
+ * @param cycle the machine's cycleCount
+ */
+void Beeper::Publish(uint64_t cycle)
+{
+    publishedCycle.store(cycle, std::memory_order_release);
+    published.store(true, std::memory_order_release);
+}
+
+uint64_t Beeper::EdgesDropped() const
+{
+    return edgesDropped;
+}
+
+BeepTracker::BeepTracker(Beeper& beeper)
+        : beeper(beeper)
+{
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include "SpscQueue.hpp"
+#include <atomic>
+
+// The beeper turning on or off, stamped with the machine's cycleCount just after the instruction
+// or timer tick that changed soundTimer
+struct BeepEdge
+{
+    uint64_t cycle;
+    bool on;
+};
+
+typedef SpscQueue<BeepEdge, 256> BeepEdgeQueue;
+
+struct BeeperSettings
+{
+    uint32_t sampleRate = 48000;
+    uint32_t clockRate = 700; //instructions per second, as the machine's Scheduler
+    uint32_t latencySamples = 256; //how far audio plays behind the emulator, about 5 ms at 48 kHz
+    float frequency = 440.0F; //square wave pitch in Hz
+    float volume = 0.25F; //peak amplitude
+};
+
+// Square wave beep for the audio thread, shaped by the edges a BeepTracker sends from the emulator thread.
+// Audio plays latencySamples behind the newest cycle the emulator published, so every edge up to the
+// sample being rendered is already queued and lands on its exact sample. Render never locks or waits;
+// if the emulator stalls or runs ahead by more than the slack, playback jumps to the new position.
+// The settings are fixed for the life of the beeper.
+class Beeper
+{
+public:
+    explicit Beeper(BeeperSettings const& settings = BeeperSettings());
+
+    void Render(float* samples, size_t count); //audio thread, mono, any buffer size
+    bool On() const; //audio thread, state of the beeper at the last rendered sample
+
+    void PushEdge(BeepEdge const& edge); //emulator thread
+    void Publish(uint64_t cycle); //emulator thread, the machine has run up to cycle
+    uint64_t EdgesDropped() const; //emulator thread, edges that didn't fit in the queue
+
+private:
+    BeeperSettings settings;
+    double cyclesPerSample;
+    double latencyCycles;
+    double slackCycles; //drift allowed before playback jumps, covers a scheduler frame between publishes
+    BeepEdgeQueue edges;
+    std::atomic<uint64_t> publishedCycle{0};
+    std::atomic<bool> published{false};
+    uint64_t edgesDropped = 0;
+
+    //Audio thread only
+    double playCycle = 0.0; //cycle of the next sample
+    bool synced = false;
+    bool on = false;
+    float phase = 0.0F; //position in the square wave's period, 0 to 1
+    BeepEdge pending{}; //edge popped but not yet reached
+    bool hasPending = false;
+};
+
+// Hooks for Chip8Core::Run(cycles, hooks) that send a BeepEdge whenever soundTimer goes from zero
+// to nonzero or back, timestamped to the instruction that did it. Timer ticks happen outside Run,
+// so call Sync after ticking; after Scheduler::RunFrame the machine sits exactly on its tick cycle.
+// Works with any Chip8Core variant.
+class BeepTracker
+{
+public:
+    explicit BeepTracker(Beeper& beeper);
+
+    template <typename Machine>
+    void Run(Machine& chip, uint32_t cycles);
+    template <typename Machine>
+    static void Runner(Machine& chip, uint32_t cycles, void* tracker); //for BasicScheduler::SetRunner
+    template <typename Machine>
+    void Sync(Machine const& chip); //sends an edge from a timer tick and publishes the current cycle
+
+    template <typename Machine>
+    bool BeforeInstruction(Machine& chip, uint16_t address)
+    {
+        (void)address;
+        Check(chip);
+        return true;
+    }
+
+    template <typename Machine>
+    void AfterInstruction(Machine& chip, uint16_t address)
+    {
+        (void)address;
+        Check(chip);
+    }
+
+private:
+    Beeper& beeper;
+    bool on = false;
+
+    template <typename Machine>
+    void Check(Machine const& chip)
+    {
+        if ((chip.soundTimer != 0) != on)
+        {
+            on = !on;
+            beeper.PushEdge(BeepEdge{chip.cycleCount, on});
+        }
+    }
+};
+
+/**
+ * @brief Run instructions, sending an edge for every instruction that starts or stops the beeper.
+ * 
+ * @param chip machine to run
+ * @param cycles instructions to execute
+ */
+template <typename Machine>
+void BeepTracker::Run(Machine& chip, uint32_t cycles)
+{
+    chip.Run(cycles, *this);
+    beeper.Publish(chip.cycleCount);
+}
+
+template <typename Machine>
+void BeepTracker::Runner(Machine& chip, uint32_t cycles, void* tracker)
+{
+    static_cast<BeepTracker*>(tracker)->Run(chip, cycles);
+}
+
+/**
+ * @brief Catch a change made outside Run, such as a timer tick, and tell the beeper how far the machine has run.
+ * 
+ * @param chip machine being tracked
+ */
+template <typename Machine>
+void BeepTracker::Sync(Machine const& chip)
+{
+    Check(chip);
+    beeper.Publish(chip.cycleCount);
+}
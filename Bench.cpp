@@ -0,0 +1,347 @@
+/**
+ * @file Bench.cpp
+ * @brief Microbenchmarks for the interpreter: per-opcode cost, whole-ROM throughput, 
+ * sprite drawing and snapshots.
+ * 
+ * Usage: bench [rom.ch8 ...]
+ * Every benchmark repeats until it has run for at least MIN_SECONDS, then reports time per operation. 
+ * ROM files given on the command line are benchmarked alongside the built-in programs.
+ * 
+ */
+
+#include "Chip8.hpp"
+#include "RomRegistry.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+const double MIN_SECONDS = 0.2;
+const uint32_t BATCH_CYCLES = 100000;
+const unsigned int PROGRAM_SIZE = 4096 - 0x200;
+
+// Opcode to benchmark on its own, repeated through memory
+struct OpcodeBenchmark
+{
+    char const* name;
+    uint16_t opcode;
+};
+
+const OpcodeBenchmark opcodeBenchmarks[] =
+{
+    {"00E0 CLS", 0x00E0U},
+    {"1NNN JP", 0x1200U},
+    {"3XKK SE", 0x3001U},
+    {"4XKK SNE", 0x4000U},
+    {"5XY0 SE", 0x5010U},
+    {"6XKK LD", 0x6012U},
+    {"7XKK ADD", 0x7001U},
+    {"8XY0 LD", 0x8010U},
+    {"8XY1 OR", 0x8011U},
+    {"8XY2 AND", 0x8012U},
+    {"8XY3 XOR", 0x8013U},
+    {"8XY4 ADD", 0x8014U},
+    {"8XY5 SUB", 0x8015U},
+    {"8XY6 SHR", 0x8016U},
+    {"8XY7 SUBN", 0x8017U},
+    {"8XYE SHL", 0x801EU},
+    {"9XY0 SNE", 0x9010U},
+    {"ANNN LD I", 0xA050U},
+    {"BNNN JP V0", 0xB200U},
+    {"CXKK RND", 0xC0FFU},
+    {"DXYN DRW", 0xD01FU},
+    {"EX9E SKP", 0xE09EU},
+    {"EXA1 SKNP", 0xE0A1U},
+    {"FX07 LD DT", 0xF007U},
+    {"FX0A LD K", 0xF00AU},
+    {"FX15 LD DT", 0xF015U},
+    {"FX18 LD ST", 0xF018U},
+    {"FX1E ADD I", 0xF01EU},
+    {"FX29 LD F", 0xF029U},
+    {"FX33 LD B", 0xF033U},
+    {"FX55 LD [I]", 0xF055U},
+    {"FX65 LD Vx", 0xF065U}
+};
+
+// SUPER-CHIP opcodes, timed on a SuperChip8 since a plain Chip8 treats them as unknown
+const OpcodeBenchmark superChipBenchmarks[] =
+{
+    {"00CN SCD", 0x00C1U},
+    {"00FB SCR", 0x00FBU},
+    {"00FC SCL", 0x00FCU},
+    {"00FD EXIT", 0x00FDU},
+    {"00FE LOW", 0x00FEU},
+    {"00FF HIGH", 0x00FFU},
+    {"FX30 LD HF", 0xF030U},
+    {"FX75 LD R", 0xF075U},
+    {"FX85 LD Vx, R", 0xF085U}
+};
+
+// Counts V0 up through a loop of arithmetic, a skip and a jump
+const uint8_t counterRom[] =
+{
+    0x60, 0x00, // 200: LD V0, 0
+    0x61, 0x03, // 202: LD V1, 3
+    0x70, 0x01, // 204: ADD V0, 1
+    0x80, 0x14, // 206: ADD V0, V1
+    0x82, 0x03, // 208: XOR V2, V0
+    0x30, 0x00, // 20A: SE V0, 0
+    0x12, 0x04, // 20C: JP 204
+    0x12, 0x00  // 20E: JP 200
+};
+
+// Bounces a digit around the screen, erasing and redrawing it every step
+const uint8_t bounceRom[] =
+{
+    0x60, 0x00, // 200: LD V0, 0
+    0x61, 0x00, // 202: LD V1, 0
+    0x62, 0x07, // 204: LD V2, 7
+    0xF2, 0x29, // 206: LD F, V2
+    0xD0, 0x15, // 208: DRW V0, V1, 5
+    0x70, 0x01, // 20A: ADD V0, 1
+    0x71, 0x01, // 20C: ADD V1, 1
+    0xD0, 0x15, // 20E: DRW V0, V1, 5
+    0x12, 0x08  // 210: JP 208
+};
+
+/**
+ * @brief Repeat a benchmark body until it has run long enough to time reliably.
+ * 
+ * @param body runs the operation being measured, returns how many operations it performed
+ * @return nanoseconds per operation
+ */
+template <typename Body>
+double Measure(Body body)
+{
+    uint64_t operations = body(); //warm up caches and branch predictors
+
+    operations = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed{};
+    while (elapsed.count() < MIN_SECONDS)
+    {
+        operations += body();
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    return elapsed.count() * 1e9 / operations;
+}
+
+void Report(char const* group, char const* name, double nanoseconds)
+{
+    printf("%-10s %-24s %10.2f ns %14.0f /s\n", group, name, nanoseconds, 1e9 / nanoseconds);
+}
+
+/**
+ * @brief Time Run() on a machine in both execution modes.
+ * 
+ * @param name label for the report
+ * @param rom program to load
+ */
+void BenchmarkRom(char const* name, std::span<const uint8_t> rom)
+{
+    ExecutionMode modes[] = {ExecutionMode::Interpreter, ExecutionMode::Threaded};
+    char const* modeNames[] = {"interp", "threaded"};
+
+    for (unsigned int m = 0; m < 2; m++)
+    {
+        Chip8 chip;
+        if (!chip.LoadROM(rom))
+        {
+            printf("%s: does not fit in memory\n", name);
+            return;
+        }
+        chip.executionMode = modes[m];
+
+        double ns = Measure([&chip]()
+        {
+            chip.Run(BATCH_CYCLES);
+            return uint64_t(BATCH_CYCLES);
+        });
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s (%s)", name, modeNames[m]);
+        Report("rom", label, ns);
+    }
+}
+
+/**
+ * @brief Time one opcode by filling program memory with it, ending in jumps back to the start.
+ * 
+ * @param benchmark opcode to time
+ */
+template <typename Machine>
+void BenchmarkOpcode(OpcodeBenchmark const& benchmark)
+{
+    std::vector<uint8_t> rom(PROGRAM_SIZE);
+    for (unsigned int i = 0; i + 4 < PROGRAM_SIZE; i += 2)
+    {
+        rom[i] = benchmark.opcode >> 8U;
+        rom[i + 1] = benchmark.opcode & 0x00FFU;
+    }
+
+    //Two jumps so a taken skip on the last opcode still lands on one
+    rom[PROGRAM_SIZE - 4] = 0x12;
+    rom[PROGRAM_SIZE - 3] = 0x00;
+    rom[PROGRAM_SIZE - 2] = 0x12;
+    rom[PROGRAM_SIZE - 1] = 0x00;
+
+    Machine chip;
+    chip.LoadROM(rom);
+    chip.registers[1] = 1;
+
+    double ns = Measure([&chip]()
+    {
+        chip.Run(BATCH_CYCLES);
+        return uint64_t(BATCH_CYCLES);
+    });
+
+    Report("opcode", benchmark.name, ns);
+}
+
+/**
+ * @brief Time 2NNN and 00EE as the pair they always run in, every call going to one shared return.
+ * 
+ */
+void BenchmarkCallReturn()
+{
+    //JP 204; RET; then CALL 202 through the rest of memory, ending in jumps back to 204
+    std::vector<uint8_t> rom(PROGRAM_SIZE);
+    rom[0] = 0x12;
+    rom[1] = 0x04;
+    rom[2] = 0x00;
+    rom[3] = 0xEE;
+    for (unsigned int i = 4; i + 4 < PROGRAM_SIZE; i += 2)
+    {
+        rom[i] = 0x22;
+        rom[i + 1] = 0x02;
+    }
+    rom[PROGRAM_SIZE - 4] = 0x12;
+    rom[PROGRAM_SIZE - 3] = 0x04;
+    rom[PROGRAM_SIZE - 2] = 0x12;
+    rom[PROGRAM_SIZE - 1] = 0x04;
+
+    Chip8 chip;
+    chip.LoadROM(rom);
+
+    double ns = Measure([&chip]()
+    {
+        chip.Run(BATCH_CYCLES);
+        return uint64_t(BATCH_CYCLES / 2);
+    });
+
+    Report("opcode", "2NNN+00EE CALL, RET", ns);
+}
+
+/**
+ * @brief Time sprite drawing through DRW, and unpacking the display for a frontend.
+ * 
+ */
+void BenchmarkDisplay()
+{
+    const uint8_t draws[] = {0xD0, 0x1F, 0x70, 0x05, 0x71, 0x03, 0x12, 0x00}; //DRW V0, V1, 15; ADD V0, 5; ADD V1, 3; JP 200
+    Chip8 chip;
+    chip.LoadROM(std::span<const uint8_t>(draws, sizeof(draws)));
+
+    double ns = Measure([&chip]()
+    {
+        chip.Run(BATCH_CYCLES);
+        return uint64_t(BATCH_CYCLES / 4);
+    });
+    Report("display", "DRW 15 rows + loop", ns);
+
+    std::vector<uint32_t> pixels(128 * 64);
+    ns = Measure([&chip, &pixels]()
+    {
+        for (unsigned int i = 0; i < 1000; i++)
+        {
+            chip.ExpandDisplay(pixels.data());
+        }
+        return uint64_t(1000);
+    });
+    Report("display", "ExpandDisplay", ns);
+}
+
+/**
+ * @brief Time taking and restoring snapshots with a few pages written since the base.
+ * 
+ */
+void BenchmarkSnapshot()
+{
+    //Scatters register stores over four pages: LD I, 300; LD [I], VF; ADD I, V0; JP 202
+    const uint8_t writer[] = {0xA3, 0x00, 0xFF, 0x55, 0xF0, 0x1E, 0x12, 0x02};
+    Chip8 chip;
+    chip.LoadROM(std::span<const uint8_t>(writer, sizeof(writer)));
+    chip.registers[0] = 0x10;
+    chip.MakeSnapshotBase();
+    chip.Run(30);
+
+    Snapshot snapshot;
+    double ns = Measure([&chip, &snapshot]()
+    {
+        for (unsigned int i = 0; i < 1000; i++)
+        {
+            chip.TakeSnapshot(snapshot);
+        }
+        return uint64_t(1000);
+    });
+    Report("snapshot", "TakeSnapshot", ns);
+
+    ns = Measure([&chip, &snapshot]()
+    {
+        for (unsigned int i = 0; i < 1000; i++)
+        {
+            chip.Restore(snapshot);
+        }
+        return uint64_t(1000);
+    });
+    Report("snapshot", "Restore (same base)", ns);
+
+    //Alternating between snapshots of two bases makes every restore a full copy of memory
+    Chip8 second;
+    second.LoadROM(std::span<const uint8_t>(writer, sizeof(writer)));
+    Snapshot secondSnapshot = second.TakeSnapshot();
+    Chip8 fork;
+    ns = Measure([&fork, &snapshot, &secondSnapshot]()
+    {
+        for (unsigned int i = 0; i < 500; i++)
+        {
+            fork.Restore(snapshot);
+            fork.Restore(secondSnapshot);
+        }
+        return uint64_t(1000);
+    });
+    Report("snapshot", "Restore (other base)", ns);
+}
+
+int main(int argc, char** argv)
+{
+    for (OpcodeBenchmark const& benchmark : opcodeBenchmarks)
+    {
+        BenchmarkOpcode<Chip8>(benchmark);
+    }
+    BenchmarkCallReturn();
+    for (OpcodeBenchmark const& benchmark : superChipBenchmarks)
+    {
+        BenchmarkOpcode<SuperChip8>(benchmark);
+    }
+
+    BenchmarkRom("counter", counterRom);
+    BenchmarkRom("bounce", bounceRom);
+
+    RomRegistry registry;
+    for (int i = 1; i < argc; i++)
+    {
+        RomHandle rom = registry.Load(argv[i]);
+        if (!rom)
+        {
+            printf("%s: can't load\n", argv[i]);
+            continue;
+        }
+        BenchmarkRom(argv[i], rom->bytes);
+    }
+
+    BenchmarkDisplay();
+    BenchmarkSnapshot();
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file Channels.cpp
+ * @brief Lock-free frame exchange between an emulator thread and a UI thread.
+ * 
+ */
+
+#include "Channels.hpp"
+
+/**
+ * @brief Exchange the freshly written back buffer with the one in transit.
+ * 
+ * @effects back by taking the buffer the UI didn't get, or gave back
+ * @effects carriedDirtyRows by keeping the rows of a frame the UI never took
+ */
+void FrameExchange::Swap()
+{
+    uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = previous & ~FRESH;
+    carriedDirtyRows = (previous & FRESH) ? buffers[back].dirtyRows : 0;
+}
+
+/**
+ * @brief Take the newest published frame, if there is one the UI hasn't seen.
+ * The frame stays valid until the next call.
+ * 
+ * @return the frame, or nullptr if no frame was published since the last call
+ */
+Frame const* FrameExchange::Acquire()
+{
+    if ((middle.load(std::memory_order_acquire) & FRESH) == 0)
+    {
+        return nullptr;
+    }
+
+    uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+    front = previous & ~FRESH;
+    return &buffers[front];
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include "SpscQueue.hpp"
+
+// A key going down or up, posted by the UI thread
+struct KeyEvent
+{
+    uint8_t key; //0 through F
+    bool pressed;
+};
+
+typedef SpscQueue<KeyEvent, 256> KeyEventQueue;
+
+// A completed frame handed from the emulator thread to the UI thread
+struct Frame
+{
+    uint64_t display[64][2]; //as Chip8::display
+    bool highResolution;
+    uint64_t dirtyRows; //rows changed since the previous frame the consumer received
+    uint64_t generation; //DisplayGeneration() when published
+    uint64_t cycleCount; //cycleCount when published
+};
+
+/**
+ * @brief Copy a machine's display into 64 rows of 128 pixels, whatever size the variant's display is.
+ * 
+ * @param chip machine to copy from, any Chip8Core variant
+ * @param rows destination, words the variant doesn't have are left alone
+ */
+template <typename Machine>
+void CopyDisplay(Machine const& chip, uint64_t (&rows)[64][2])
+{
+    for (unsigned int row = 0; row < Machine::DISPLAY_ROWS; row++)
+    {
+        for (unsigned int word = 0; word < Machine::ROW_WORDS; word++)
+        {
+            rows[row][word] = chip.display[row][word];
+        }
+    }
+}
+
+// Triple buffer between one emulator thread publishing frames and one UI thread reading them.
+// Neither side ever waits: the emulator always has a buffer to write, and the UI gets
+// the newest complete frame, with the dirty rows of any frames it missed folded in.
+class FrameExchange
+{
+public:
+    template <typename Machine>
+    void Publish(Machine& chip); //emulator thread, takes the machine's dirty rows
+    Frame const* Acquire(); //UI thread, newest frame or nullptr if nothing new since the last call
+
+private:
+    static const uint8_t FRESH = 4; //set in middle when it holds a frame the UI hasn't taken
+
+    Frame buffers[3]{};
+    alignas(64) std::atomic<uint8_t> middle{1}; //buffer in transit, plus FRESH
+    alignas(64) uint8_t back = 0; //owned by the emulator thread
+    uint64_t carriedDirtyRows = 0; //dirty rows of a frame the UI never took
+    alignas(64) uint8_t front = 2; //owned by the UI thread
+
+    void Swap(); //hands the back buffer to the UI
+};
+
+/**
+ * @brief Copy the machine's display into the back buffer and make it the newest frame.
+ * If the UI never took the frame this one replaces, its dirty rows are carried into the next frame 
+ * so the UI still learns every row that changed.
+ * 
+ * @param chip machine whose display to publish, any Chip8Core variant
+ * @effects chip by clearing its dirty rows, which now belong to the published frame
+ */
+template <typename Machine>
+void FrameExchange::Publish(Machine& chip)
+{
+    Frame& frame = buffers[back];
+    CopyDisplay(chip, frame.display);
+    frame.highResolution = chip.highResolution;
+    frame.dirtyRows = chip.DirtyRows() | carriedDirtyRows;
+    frame.generation = chip.DisplayGeneration();
+    frame.cycleCount = chip.cycleCount;
+    chip.ClearDirtyRows();
+    Swap();
+}
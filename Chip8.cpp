@@ -10,100 +10,1632 @@
  */
 
 #include "Chip8.hpp"
+#include "RomRegistry.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHIP8_BLIT_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CHIP8_BLIT_NEON
+#endif
 
 
 const unsigned int START_ADDRESS = 0x200;
 const unsigned int FONT_ADDRESS = 0x50;
 const unsigned int FIRST_TWELVE_BITS = 0xFFFU;
 const unsigned int FONTSET_SIZE = 80;
+const unsigned int BIG_FONT_ADDRESS = FONT_ADDRESS + FONTSET_SIZE;
+const unsigned int BIG_FONTSET_SIZE = 100;
+const unsigned int MAX_ROM_SIZE = 4096 - START_ADDRESS;
 const unsigned int REGISTER_VF = 15;
 const unsigned int REGISTER_V0 = 0;
+const unsigned int DECODE_SLOTS = 4096 / 2;
+const unsigned int MAX_BLOCK_LENGTH = 32;
+const unsigned int PAGE_SIZE = 64;
+const unsigned int VIDEO_WIDTH = 64;
+const unsigned int VIDEO_HEIGHT = 32;
+const unsigned int HIRES_WIDTH = 128;
+const unsigned int HIRES_HEIGHT = 64;
+const unsigned int SCROLL_PIXELS = 4;
+const uint64_t LEFTMOST_PIXEL = 1ULL << 63U;
+const uint64_t PCG_MULTIPLIER = 6364136223846793005ULL;
+const uint16_t SUPER_CHIP_VARIANT = 0x10U; //StateVariant bit of machines with the SUPER-CHIP display
+
+constexpr uint8_t fontset[FONTSET_SIZE] =
+{
+	0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
+	0x20, 0x60, 0x20, 0x20, 0x70, // 1
+	0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
+	0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
+	0x90, 0x90, 0xF0, 0x10, 0x10, // 4
+	0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
+	0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
+	0xF0, 0x10, 0x20, 0x40, 0x40, // 7
+	0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
+	0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
+	0xF0, 0x90, 0xF0, 0x90, 0x90, // A
+	0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
+	0xF0, 0x80, 0x80, 0x80, 0xF0, // C
+	0xE0, 0x90, 0x90, 0x90, 0xE0, // D
+	0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
+	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
+};
+
+constexpr uint8_t bigFontset[BIG_FONTSET_SIZE] =
+{
+	0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+	0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+	0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+	0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+	0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+	0x3E, 0x7C, 0xE0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+	0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+	0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+	0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C  // 9
+};
+
+// Hundreds, tens and ones digits of every byte value, for FX33
+struct BcdTable
+{
+    uint8_t digits[256][3];
+};
+
+constexpr BcdTable MakeBcdTable()
+{
+    BcdTable table{};
+    for (unsigned int value = 0; value < 256; value++)
+    {
+        table.digits[value][0] = value / 100;
+        table.digits[value][1] = value / 10 % 10;
+        table.digits[value][2] = value % 10;
+    }
+    return table;
+}
+
+constexpr BcdTable bcdTable = MakeBcdTable();
+
+// Memory of a freshly booted machine: both fonts, everything else zero
+struct BootImage
+{
+    uint8_t memory[4096];
+};
+
+constexpr BootImage MakeBootImage()
+{
+    BootImage image{};
+    for (unsigned int i = 0; i < FONTSET_SIZE; i++)
+    {
+        image.memory[FONT_ADDRESS + i] = fontset[i];
+    }
+    for (unsigned int i = 0; i < BIG_FONTSET_SIZE; i++)
+    {
+        image.memory[BIG_FONT_ADDRESS + i] = bigFontset[i];
+    }
+    return image;
+}
+
+constexpr BootImage bootImage = MakeBootImage();
+
+// Everything but memory of a freshly booted machine, before its generator is seeded
+constexpr MachineState MakeBootState()
+{
+    MachineState state{};
+    state.pcRegister = START_ADDRESS;
+    return state;
+}
+
+constexpr MachineState bootState = MakeBootState();
+
+template <typename Quirks>
+Chip8Core<Quirks>::Chip8Core()
+        : Chip8Core(std::chrono::system_clock::now().time_since_epoch().count())
+{
+}
+
+/**
+ * @brief Construct a machine whose random numbers are reproducible.
+ * 
+ * @param seed starting point of the random sequence
+ * @param stream selects one of 2^63 independent sequences, so parallel machines can share a seed
+ */
+template <typename Quirks>
+Chip8Core<Quirks>::Chip8Core(uint64_t seed, uint64_t stream)
+{
+    //Set initial PC address
+    pcRegister = START_ADDRESS;
+
+    //Fonts in memory, the rest zeroed
+    memcpy(memory, bootImage.memory, sizeof(memory));
+
+    SeedRandom(seed, stream);
+}
+
+/**
+ * @brief Restart the built-in random sequence used by RND.
+ * 
+ * @param seed starting point of the random sequence
+ * @param stream selects one of 2^63 independent sequences
+ * @effects rng by reseeding it
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::SeedRandom(uint64_t seed, uint64_t stream)
+{
+    rng.Seed(seed, stream);
+}
+
+/**
+ * @brief Replace the built-in generator used by RND, e.g. to feed recorded values back in.
+ * 
+ * @param source called once per RND for a random byte, or nullptr for the built-in generator
+ * @param context passed to every call of source
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::SetRandomSource(RandomSource source, void* context)
+{
+    randomSource = source;
+    randomContext = context;
+}
+
+/**
+ * @brief Start the generator at a seed on one of its streams, as in the PCG reference implementation.
+ * 
+ * @param seed starting point of the sequence
+ * @param stream sequence to use
+ */
+void Pcg32::Seed(uint64_t seed, uint64_t stream)
+{
+    state = 0;
+    increment = (stream << 1U) | 1U;
+    Next();
+    state += seed;
+    Next();
+}
+
+/**
+ * @brief Advance the generator. PCG-XSH-RR: a 64-bit LCG step, output through a xorshift and random rotate.
+ * 
+ * @return the next 32 random bits
+ */
+uint32_t Pcg32::Next()
+{
+    uint64_t old = state;
+    state = old * PCG_MULTIPLIER + increment;
+    uint32_t xorshifted = static_cast<uint32_t>(((old >> 18U) ^ old) >> 27U);
+    uint32_t rotation = static_cast<uint32_t>(old >> 59U);
+    return (xorshifted >> rotation) | (xorshifted << ((32U - rotation) & 31U));
+}
+
+/**
+ * @brief Find an image in a state file, typically a MappedFile, without copying it.
+ * Only the header is checked here, Restore checks that the image suits the machine.
+ * 
+ * @param bytes whole state file, at least 8 byte aligned as mappings are
+ * @param index image number, the file's images being sizeof(StateImage) bytes each
+ * @return the image, or nullptr if the file is too short, misaligned or its header isn't a state header
+ */
+StateImage const* MapStateImage(std::span<const uint8_t> bytes, size_t index)
+{
+    size_t offset = index * sizeof(StateImage);
+    if (bytes.size() / sizeof(StateImage) <= index || reinterpret_cast<uintptr_t>(bytes.data()) % alignof(StateImage) != 0)
+    {
+        return nullptr;
+    }
+
+    StateImage const* image = reinterpret_cast<StateImage const*>(bytes.data() + offset);
+    if (image->header.magic != STATE_MAGIC || image->header.imageSize != sizeof(StateImage))
+    {
+        return nullptr;
+    }
+    return image;
+}
+
+/**
+ * @brief Check a machine state read from outside, such as a file, before any machine loads it.
+ * The highResolution bool is read as a byte, so a corrupt byte is caught rather than loaded.
+ * 
+ * @param state state to check, possibly holding any bytes at all
+ * @param variant StateVariant() of the machine it is for
+ * @return false if no machine of the variant can be in the state: sp past the stack, 
+ * or highResolution not 0 or 1, or set without SUPER-CHIP
+ */
+bool ValidMachineState(MachineState const& state, uint16_t variant)
+{
+    uint8_t highResolutionByte;
+    memcpy(&highResolutionByte, reinterpret_cast<const uint8_t*>(&state) + offsetof(MachineState, highResolution), 1);
+    return highResolutionByte <= ((variant & SUPER_CHIP_VARIANT) ? 1U : 0U) && state.sp < 16;
+}
+
+/**
+ * @brief Load a ROM file by mapping it into the address space, without an intermediate buffer.
+ * 
+ * @param filename path of the ROM
+ * @return false if the file can't be opened or the ROM doesn't fit in memory
+ */
+template <typename Quirks>
+bool Chip8Core<Quirks>::LoadROM(char const* filename)
+{
+    MappedFile rom(filename);
+    if (!rom.IsOpen())
+    {
+        return false;
+    }
+
+    return LoadROM(rom.Bytes());
+}
+
+/**
+ * @brief Load a ROM from a buffer and decode it.
+ * 
+ * @param rom contents of the ROM
+ * @effects memory by copying the ROM to START_ADDRESS and clearing the rest of program memory
+ * @effects decodeCache by decoding the new memory image
+ * @return false, leaving the machine untouched, if the ROM is larger than program memory
+ */
+template <typename Quirks>
+bool Chip8Core<Quirks>::LoadROM(std::span<const uint8_t> rom)
+{
+    if (rom.size() > MAX_ROM_SIZE)
+    {
+        return false;
+    }
+
+    CopyROM(rom);
+    BuildDecodeCache();
+    return true;
+}
+
+/**
+ * @brief Load a shared ROM image, reusing its decoded instructions instead of decoding again.
+ * The image was decoded assuming only the fontset below START_ADDRESS, 
+ * so those pages are decoded on the fly in case this machine's differ.
+ * 
+ * @param rom image from a RomRegistry
+ * @effects memory by copying the ROM to START_ADDRESS and clearing the rest of program memory
+ * @effects decodeCache by sharing rom.decoded
+ * @return false, leaving the machine untouched, if the ROM is larger than program memory
+ */
+template <typename Quirks>
+bool Chip8Core<Quirks>::LoadROM(RomImage const& rom)
+{
+    if (rom.bytes.size() > MAX_ROM_SIZE || !rom.decoded)
+    {
+        return false;
+    }
+
+    CopyROM(rom.bytes);
+    decodeCache = rom.decoded;
+    modifiedPages = (1ULL << (START_ADDRESS >> 6U)) - 1U;
+    return true;
+}
+
+/**
+ * @brief Return the machine to exactly the state a new one would boot into with a shared ROM loaded, 
+ * so machines can be pooled and reused instead of constructed for every run.
+ * Memory below the ROM is copied from the constant boot image, which is what rom.decoded was built from, 
+ * so unlike LoadROM every decoded instruction can be used. executionMode and any random source are kept.
+ * 
+ * @param rom image from a RomRegistry
+ * @param seed starting point of the random sequence
+ * @param stream selects one of 2^63 independent sequences
+ * @effects memory, registers, timers, stack, keypad, display, cycleCount and rng by setting to a new machine's
+ * @effects decodeCache by sharing rom.decoded, and snapshotBase by dropping it
+ * @return false, leaving the machine untouched, if the ROM is larger than program memory or wasn't decoded
+ */
+template <typename Quirks>
+bool Chip8Core<Quirks>::Reset(RomImage const& rom, uint64_t seed, uint64_t stream)
+{
+    if (rom.bytes.size() > MAX_ROM_SIZE || !rom.decoded)
+    {
+        return false;
+    }
+
+    memcpy(memory, bootImage.memory, START_ADDRESS);
+    CopyROM(rom.bytes);
+    decodeCache = rom.decoded;
+    modifiedPages = 0;
+
+    LoadState(bootState);
+    ins = DecodedInstruction{};
+    opcode = 0;
+    SeedRandom(seed, stream);
+    return true;
+}
+
+/**
+ * @brief Decode a ROM as it would appear in a freshly booted machine, 
+ * for sharing between every machine that loads it.
+ * 
+ * @param rom contents of the ROM, at most 4096 - START_ADDRESS bytes
+ * @return the decoded program, or nullptr if the ROM is too large
+ */
+template <typename Quirks>
+std::shared_ptr<const DecodedProgram> Chip8Core<Quirks>::Predecode(std::span<const uint8_t> rom)
+{
+    if (rom.size() > MAX_ROM_SIZE)
+    {
+        return nullptr;
+    }
+
+    BootImage image = bootImage;
+    if (!rom.empty())
+    {
+        memcpy(image.memory + START_ADDRESS, rom.data(), rom.size());
+    }
+    return DecodeImage(image.memory);
+}
+
+/**
+ * @brief Copy a ROM into program memory with a single bulk copy.
+ * 
+ * @param rom contents of the ROM, at most MAX_ROM_SIZE bytes
+ * @effects memory by copying rom to START_ADDRESS and zeroing everything after it
+ * @effects snapshotBase by dropping it
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::CopyROM(std::span<const uint8_t> rom)
+{
+    if (!rom.empty())
+    {
+        memcpy(memory + START_ADDRESS, rom.data(), rom.size());
+    }
+    memset(memory + START_ADDRESS + rom.size(), 0, MAX_ROM_SIZE - rom.size());
+
+    //Earlier snapshots no longer describe this memory
+    snapshotBase.reset();
+    snapshotDirtyPages = ~0ULL;
+}
+
+/**
+ * @brief Value of a hex digit of an opcode pattern, or -1 for an operand X, Y, N or K.
+ * Any other character is not constant, so a misspelt pattern fails to compile.
+ * 
+ * @param c character of a pattern name such as "8XY4"
+ * @return 0 to 15, or -1 for an operand nibble
+ */
+constexpr int PatternNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c == 'X' || c == 'Y' || c == 'N' || c == 'K')
+    {
+        return -1;
+    }
+    throw "opcode patterns are hex digits and X, Y, N or K";
+}
+
+// Any opcode where (opcode & mask) == match is executed by the handler at the same index.
+// The mask and match are read from the name, whose hex digits are fixed and whose letters are operands,
+// so the name shown in profiles and disassembly is the one description of the pattern.
+struct OpcodePattern
+{
+    uint16_t mask;
+    uint16_t match;
+    bool endsBlock; //may branch or write memory
+    char const* name;
+
+    constexpr OpcodePattern(char const* name, bool endsBlock)
+            : mask(0), match(0), endsBlock(endsBlock), name(name)
+    {
+        if (name[0] == 'N' && name[1] == 'U' && name[2] == 'L' && name[3] == 'L')
+        {
+            return; //catches everything
+        }
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            int nibble = PatternNibble(name[i]);
+            mask = mask << 4U | (nibble < 0 ? 0x0U : 0xFU);
+            match = match << 4U | (nibble < 0 ? 0x0U : nibble);
+        }
+        if (name[4] != '\0')
+        {
+            throw "opcode patterns are four characters";
+        }
+    }
+};
+
+/**
+ * @brief Opcode patterns, in the same order as the handlers of every variant.
+ * Entry 0 masks no bits so it matches every opcode that no other entry claims.
+ * The second column marks instructions that may change the PC or write memory, which end a basic block.
+ * 
+ */
+constexpr OpcodePattern opcodePatterns[] =
+{
+    {"NULL", false},
+    {"00E0", false},
+    {"00EE", true},
+    {"00CN", false},
+    {"00FB", false},
+    {"00FC", false},
+    {"00FD", true},
+    {"00FE", false},
+    {"00FF", false},
+    {"1NNN", true},
+    {"2NNN", true},
+    {"3XKK", true},
+    {"4XKK", true},
+    {"5XY0", true},
+    {"6XKK", false},
+    {"7XKK", false},
+    {"8XY0", false},
+    {"8XY1", false},
+    {"8XY2", false},
+    {"8XY3", false},
+    {"8XY4", false},
+    {"8XY5", false},
+    {"8XY6", false},
+    {"8XY7", false},
+    {"8XYE", false},
+    {"9XY0", true},
+    {"ANNN", false},
+    {"BNNN", true},
+    {"CXKK", false},
+    {"DXYN", false},
+    {"EX9E", true},
+    {"EXA1", true},
+    {"FX07", false},
+    {"FX0A", true},
+    {"FX15", false},
+    {"FX18", false},
+    {"FX1E", false},
+    {"FX29", false},
+    {"FX30", false},
+    {"FX33", true},
+    {"FX55", true},
+    {"FX65", false},
+    {"FX75", false},
+    {"FX85", false}
+};
+
+const unsigned int OPCODE_COUNT = sizeof(opcodePatterns) / sizeof(opcodePatterns[0]);
+
+/**
+ * @brief Whether no opcode matches two patterns, so the order of the table can't change what an opcode runs.
+ * Two patterns overlap when they agree on every nibble both of them fix.
+ * 
+ * @return false if some pair of patterns after the catch-all overlaps
+ */
+constexpr bool PatternsDisjoint()
+{
+    for (unsigned int i = 1; i < OPCODE_COUNT; i++)
+    {
+        for (unsigned int j = i + 1; j < OPCODE_COUNT; j++)
+        {
+            uint16_t shared = opcodePatterns[i].mask & opcodePatterns[j].mask;
+            if (((opcodePatterns[i].match ^ opcodePatterns[j].match) & shared) == 0)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(OPCODE_COUNT <= 256, "handler indices are stored in a byte");
+static_assert(opcodePatterns[0].mask == 0, "entry 0 must catch unknown opcodes");
+static_assert(PatternsDisjoint(), "an opcode matches two patterns");
+
+// Handler index of every opcode
+struct DispatchTable
+{
+    uint8_t handler[0x10000];
+};
+
+/**
+ * @brief Fill in the handler index of all 65536 opcodes at compile time,
+ * so executing an instruction is a single lookup into read-only data shared by every machine.
+ * Each pattern only visits the opcodes it matches, by counting through the bits its mask leaves free.
+ * 
+ * @return the table, 0 for opcodes no pattern claims
+ */
+constexpr DispatchTable MakeDispatchTable()
+{
+    DispatchTable table{};
+    for (unsigned int i = 1; i < OPCODE_COUNT; i++)
+    {
+        uint16_t operands = ~opcodePatterns[i].mask;
+        uint16_t bits = 0;
+        do
+        {
+            table.handler[opcodePatterns[i].match | bits] = i;
+            bits = (bits - operands) & operands; //next combination of operand bits
+        } while (bits != 0);
+    }
+    return table;
+}
+
+constexpr DispatchTable dispatchTable = MakeDispatchTable();
+
+/**
+ * @brief Handler of each opcode pattern, compiled once per variant with its quirks.
+ * 
+ */
+template <typename Quirks>
+const typename Chip8Core<Quirks>::Chip8Func Chip8Core<Quirks>::handlers[] =
+{
+    &Chip8Core::OP_NULL,
+    &Chip8Core::OP_00E0,
+    &Chip8Core::OP_00EE,
+    &Chip8Core::OP_00CN,
+    &Chip8Core::OP_00FB,
+    &Chip8Core::OP_00FC,
+    &Chip8Core::OP_00FD,
+    &Chip8Core::OP_00FE,
+    &Chip8Core::OP_00FF,
+    &Chip8Core::OP_1NNN,
+    &Chip8Core::OP_2NNN,
+    &Chip8Core::OP_3XKK,
+    &Chip8Core::OP_4XKK,
+    &Chip8Core::OP_5XY0,
+    &Chip8Core::OP_6XKK,
+    &Chip8Core::OP_7XKK,
+    &Chip8Core::OP_8XY0,
+    &Chip8Core::OP_8XY1,
+    &Chip8Core::OP_8XY2,
+    &Chip8Core::OP_8XY3,
+    &Chip8Core::OP_8XY4,
+    &Chip8Core::OP_8XY5,
+    &Chip8Core::OP_8XY6,
+    &Chip8Core::OP_8XY7,
+    &Chip8Core::OP_8XYE,
+    &Chip8Core::OP_9XY0,
+    &Chip8Core::OP_ANNN,
+    &Chip8Core::OP_BNNN,
+    &Chip8Core::OP_CXKK,
+    &Chip8Core::OP_DXYN,
+    &Chip8Core::OP_EX9E,
+    &Chip8Core::OP_EXA1,
+    &Chip8Core::OP_FX07,
+    &Chip8Core::OP_FX0A,
+    &Chip8Core::OP_FX15,
+    &Chip8Core::OP_FX18,
+    &Chip8Core::OP_FX1E,
+    &Chip8Core::OP_FX29,
+    &Chip8Core::OP_FX30,
+    &Chip8Core::OP_FX33,
+    &Chip8Core::OP_FX55,
+    &Chip8Core::OP_FX65,
+    &Chip8Core::OP_FX75,
+    &Chip8Core::OP_FX85
+};
+
+/**
+ * @brief Number of opcode patterns, the range of DecodedInstruction::handler.
+ */
+template <typename Quirks>
+unsigned int Chip8Core<Quirks>::HandlerCount()
+{
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == OPCODE_COUNT, "every opcode pattern needs a handler");
+    return OPCODE_COUNT;
+}
+
+/**
+ * @brief Look up the handler an opcode executes, the same in every variant, 
+ * so tools decode instructions exactly as the interpreter does.
+ * 
+ * @param opcode any 16-bit opcode
+ * @return index for HandlerName, 0 for opcodes no pattern claims
+ */
+template <typename Quirks>
+uint8_t Chip8Core<Quirks>::HandlerOf(uint16_t opcode)
+{
+    return dispatchTable.handler[opcode];
+}
+
+/**
+ * @brief Opcode pattern of a handler, for profiles and disassembly.
+ * 
+ * @param handler index from DecodedInstruction::handler
+ * @return the pattern, such as "DXYN", or "NULL" for unknown opcodes
+ */
+template <typename Quirks>
+char const* Chip8Core<Quirks>::HandlerName(uint8_t handler)
+{
+    return handler < OPCODE_COUNT ? opcodePatterns[handler].name : opcodePatterns[0].name;
+}
+
+template <typename Quirks>
+DecodedInstruction const& Chip8Core<Quirks>::CurrentInstruction() const
+{
+    return ins;
+}
+
+/**
+ * @brief Read the big-endian opcode stored at an address of a memory image, wrapping around the 4 kB address space.
+ * 
+ * @param image 4 kB memory image
+ * @param address location of the opcode's high byte
+ * @return the two byte opcode
+ */
+template <typename Quirks>
+uint16_t Chip8Core<Quirks>::ReadOpcode(const uint8_t* image, uint16_t address)
+{
+    return (image[address & FIRST_TWELVE_BITS] << 8U) | image[(address + 1U) & FIRST_TWELVE_BITS];
+}
+
+/**
+ * @brief Read the opcode stored at an address of this machine's memory.
+ * 
+ * @param address location of the opcode's high byte
+ * @return the two byte opcode
+ */
+template <typename Quirks>
+uint16_t Chip8Core<Quirks>::FetchOpcode(uint16_t address) const
+{
+    return ReadOpcode(memory, address);
+}
+
+/**
+ * @brief Split an opcode into its operand fields and look up its handler.
+ * 
+ * @param op the two byte opcode
+ * @return the decoded instruction
+ */
+template <typename Quirks>
+DecodedInstruction Chip8Core<Quirks>::Decode(uint16_t op)
+{
+    DecodedInstruction decoded;
+    decoded.opcode = op;
+    decoded.nnn = op & FIRST_TWELVE_BITS;
+    decoded.kk = op & 0x00FFU;
+    decoded.n = op & 0x000FU;
+    decoded.x = (op & 0x0F00U) >> 8U;
+    decoded.y = (op & 0x00F0U) >> 4U;
+    decoded.handler = dispatchTable.handler[op];
+    decoded.blockLength = 1;
+    return decoded;
+}
+
+/**
+ * @brief Decode the instruction at every even address of a memory image.
+ * Each slot also records how many instructions run straight through from it, 
+ * up to and including the next one that can branch or write memory.
+ * 
+ * @param image 4 kB memory image
+ * @return the decoded program
+ */
+template <typename Quirks>
+std::shared_ptr<DecodedProgram> Chip8Core<Quirks>::DecodeImage(const uint8_t* image)
+{
+    std::shared_ptr<DecodedProgram> cache = std::make_shared<DecodedProgram>();
+    for (unsigned int i = 0; i < DECODE_SLOTS; i++)
+    {
+        cache->slots[i] = Decode(ReadOpcode(image, i * 2));
+    }
+
+    //Work backwards so each slot extends the block that follows it
+    for (unsigned int i = DECODE_SLOTS; i-- > 0;)
+    {
+        DecodedInstruction& slot = cache->slots[i];
+        if (opcodePatterns[slot.handler].endsBlock || i + 1 == DECODE_SLOTS)
+        {
+            slot.blockLength = 1;
+        } else
+        {
+            uint8_t next = cache->slots[i + 1].blockLength;
+            slot.blockLength = next < MAX_BLOCK_LENGTH ? next + 1 : MAX_BLOCK_LENGTH;
+        }
+    }
+
+    return cache;
+}
+
+/**
+ * @brief Decode this machine's memory into a new decodeCache.
+ * 
+ * @effects decodeCache by replacing it with a decoding of the current memory image
+ * @effects modifiedPages by clearing, since every page now matches the cache
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::BuildDecodeCache()
+{
+    decodeCache = DecodeImage(memory);
+    modifiedPages = 0;
+}
+
+/**
+ * @brief Record a write to memory so stale pre-decoded instructions are no longer used.
+ * 
+ * @param address first byte written
+ * @param length number of bytes written, wrapping around the 4 kB address space
+ * @effects modifiedPages and snapshotDirtyPages by setting the bit of every 64 byte page touched
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::MarkWritten(uint16_t address, uint16_t length)
+{
+    unsigned int first = (address & FIRST_TWELVE_BITS) >> 6U;
+    unsigned int last = ((address + length - 1U) & FIRST_TWELVE_BITS) >> 6U;
+
+    uint64_t pages;
+    if (first <= last)
+    {
+        pages = (~0ULL << first) & (~0ULL >> (63U - last));
+    } else
+    {
+        pages = (~0ULL << first) | (~0ULL >> (63U - last));
+    }
+
+    modifiedPages |= pages;
+    snapshotDirtyPages |= pages;
+}
+
+/**
+ * @brief Copy bytes into memory starting at an address, wrapping around the 4 kB address space, 
+ * as at most two block moves so no byte lands outside memory.
+ * 
+ * @param memory 4 kB memory image
+ * @param address where the first byte goes, only the lowest 12 bits are used
+ * @param bytes data to copy
+ * @param length number of bytes, at most 4096
+ */
+static void CopyToMemory(uint8_t* memory, uint16_t address, const uint8_t* bytes, unsigned int length)
+{
+    unsigned int start = address & FIRST_TWELVE_BITS;
+    unsigned int first = length < 4096U - start ? length : 4096U - start;
+    memcpy(memory + start, bytes, first);
+    memcpy(memory, bytes + first, length - first);
+}
+
+/**
+ * @brief Copy bytes out of memory starting at an address, wrapping around the 4 kB address space, 
+ * as at most two block moves so no byte is read from outside memory.
+ * 
+ * @param bytes destination
+ * @param memory 4 kB memory image
+ * @param address where the first byte is read, only the lowest 12 bits are used
+ * @param length number of bytes, at most 4096
+ */
+static void CopyFromMemory(uint8_t* bytes, const uint8_t* memory, uint16_t address, unsigned int length)
+{
+    unsigned int start = address & FIRST_TWELVE_BITS;
+    unsigned int first = length < 4096U - start ? length : 4096U - start;
+    memcpy(bytes, memory + start, first);
+    memcpy(bytes + first, memory, length - first);
+}
+
+/**
+ * @brief Copy everything but memory into a MachineState.
+ * The padding between fields is cleared too, so equal machines give byte-identical states.
+ * 
+ * @param state destination
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::SaveState(MachineState& state) const
+{
+    memset(&state, 0, sizeof(state));
+    memcpy(state.registers, registers, sizeof(registers));
+    state.pcRegister = pcRegister;
+    state.indexRegister = indexRegister;
+    memcpy(state.stack, stack, sizeof(stack));
+    state.sp = sp;
+    state.timer = timer;
+    state.soundTimer = soundTimer;
+    memcpy(state.keypad, keypad, sizeof(keypad));
+    memcpy(state.display, display, sizeof(display));
+    state.highResolution = highResolution;
+    memcpy(state.rplFlags, rplFlags, sizeof(rplFlags));
+    state.dirtyRows = dirtyRows;
+    state.displayGeneration = displayGeneration;
+    state.cycleCount = cycleCount;
+    state.rng = rng;
+}
+
+/**
+ * @brief Set everything but memory from a MachineState.
+ * 
+ * @param state source
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::LoadState(MachineState const& state)
+{
+    memcpy(registers, state.registers, sizeof(registers));
+    pcRegister = state.pcRegister;
+    indexRegister = state.indexRegister;
+    memcpy(stack, state.stack, sizeof(stack));
+    sp = state.sp;
+    timer = state.timer;
+    soundTimer = state.soundTimer;
+    memcpy(keypad, state.keypad, sizeof(keypad));
+    memcpy(display, state.display, sizeof(display));
+    highResolution = state.highResolution;
+    memcpy(rplFlags, state.rplFlags, sizeof(rplFlags));
+    dirtyRows = state.dirtyRows;
+    displayGeneration = state.displayGeneration;
+    cycleCount = state.cycleCount;
+    rng = state.rng;
+}
+
+/**
+ * @brief Copy all of memory into a new base that later snapshots of this machine store their changes against.
+ * Memory is only tracked through instructions and LoadROM, so take a new base after writing memory directly.
+ * 
+ * @effects snapshotBase by replacing it with the new base
+ * @effects snapshotDirtyPages by clearing
+ * @return the new base, which other machines can share through the snapshots built on it
+ */
+template <typename Quirks>
+std::shared_ptr<const SnapshotBase> Chip8Core<Quirks>::MakeSnapshotBase()
+{
+    std::shared_ptr<SnapshotBase> base = std::make_shared<SnapshotBase>();
+    memcpy(base->memory, memory, sizeof(memory));
+    base->decodeCache = decodeCache;
+    base->modifiedPages = modifiedPages;
+
+    snapshotBase = base;
+    snapshotDirtyPages = 0;
+    return base;
+}
+
+/**
+ * @brief Capture the machine, storing only the memory pages written since the current base.
+ * A base is taken first if there is none yet.
+ * 
+ * @param snapshot destination, its page buffer is reused so steady-state snapshots don't allocate
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::TakeSnapshot(Snapshot& snapshot)
+{
+    if (!snapshotBase)
+    {
+        MakeSnapshotBase();
+    }
+
+    snapshot.base = snapshotBase;
+    snapshot.pages = snapshotDirtyPages;
+    snapshot.pageData.resize(std::popcount(snapshotDirtyPages) * PAGE_SIZE);
+
+    uint8_t* next = snapshot.pageData.data();
+    for (uint64_t pages = snapshotDirtyPages; pages != 0; pages &= pages - 1)
+    {
+        memcpy(next, memory + std::countr_zero(pages) * PAGE_SIZE, PAGE_SIZE);
+        next += PAGE_SIZE;
+    }
+
+    SaveState(snapshot.state);
+}
+
+/**
+ * @brief Capture the machine into a new snapshot.
+ * 
+ * @return the snapshot
+ */
+template <typename Quirks>
+Snapshot Chip8Core<Quirks>::TakeSnapshot()
+{
+    Snapshot snapshot;
+    TakeSnapshot(snapshot);
+    return snapshot;
+}
+
+/**
+ * @brief Return the machine to a snapshot, which may come from another machine.
+ * If the snapshot shares this machine's base, only pages written since the base are copied back.
+ * 
+ * @param snapshot state to restore
+ * @effects memory, registers, timers, stack, keypad and display by setting to the snapshot's
+ * @effects decodeCache and modifiedPages so pages changed since the cache was built are decoded from memory
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::Restore(Snapshot const& snapshot)
+{
+    SnapshotBase const& base = *snapshot.base;
+
+    if (snapshot.base == snapshotBase)
+    {
+        for (uint64_t pages = snapshotDirtyPages & ~snapshot.pages; pages != 0; pages &= pages - 1)
+        {
+            unsigned int offset = std::countr_zero(pages) * PAGE_SIZE;
+            memcpy(memory + offset, base.memory + offset, PAGE_SIZE);
+        }
+    } else
+    {
+        memcpy(memory, base.memory, sizeof(memory));
+        snapshotBase = snapshot.base;
+    }
+
+    const uint8_t* next = snapshot.pageData.data();
+    for (uint64_t pages = snapshot.pages; pages != 0; pages &= pages - 1)
+    {
+        memcpy(memory + std::countr_zero(pages) * PAGE_SIZE, next, PAGE_SIZE);
+        next += PAGE_SIZE;
+    }
+
+    snapshotDirtyPages = snapshot.pages;
+    decodeCache = base.decodeCache;
+    modifiedPages = base.modifiedPages | snapshot.pages;
+
+    LoadState(snapshot.state);
+}
+
+/**
+ * @brief Identify a variant in state images: its quirks in bits 0 to 4, so images only restore into 
+ * machines that would run them the same way.
+ * 
+ * @return quirk bits of this variant
+ */
+template <typename Quirks>
+uint16_t Chip8Core<Quirks>::StateVariant()
+{
+    return (Quirks::shiftUsesVy ? 0x01U : 0U) | (Quirks::jumpUsesVx ? 0x02U : 0U) | (Quirks::loadStoreIncrementsI ? 0x04U : 0U)
+            | (Quirks::logicResetsVF ? 0x08U : 0U) | (Quirks::superChip ? SUPER_CHIP_VARIANT : 0U);
+}
+
+/**
+ * @brief Capture the whole machine, memory included, in the fixed state file layout.
+ * The image is cleared first so its padding is zero and identical states give identical bytes.
+ * 
+ * @param image destination, ready to be written to a file as it is
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::SaveImage(StateImage& image) const
+{
+    memset(&image, 0, sizeof(image));
+    image.header.magic = STATE_MAGIC;
+    image.header.version = STATE_VERSION;
+    image.header.variant = StateVariant();
+    image.header.imageSize = sizeof(StateImage);
+    SaveState(image.state);
+    memcpy(image.memory, memory, sizeof(memory));
+}
+
+/**
+ * @brief Return the machine to a state image, typically one mapped from a state file.
+ * 
+ * @param image state to restore, saved by the same variant
+ * @effects memory, registers, timers, stack, keypad and display by setting to the image's
+ * @effects decodeCache by decoding the restored memory, and snapshotBase by dropping it
+ * @effects pcRegister and indexRegister by masking to 12 bits
+ * @return false, leaving the machine unchanged, if the image has another version, variant or size, 
+ * or a state no machine of this variant can be in: sp past the stack, or highResolution not 0 or 1, 
+ * or set without SUPER-CHIP
+ */
+template <typename Quirks>
+bool Chip8Core<Quirks>::Restore(StateImage const& image)
+{
+    if (image.header.magic != STATE_MAGIC || image.header.version != STATE_VERSION
+            || image.header.variant != StateVariant() || image.header.imageSize != sizeof(StateImage))
+    {
+        return false;
+    }
+
+    if (!ValidMachineState(image.state, StateVariant()))
+    {
+        return false;
+    }
+
+    memcpy(memory, image.memory, sizeof(memory));
+    LoadState(image.state);
+    BuildDecodeCache();
+
+    //Every use masks them to 12 bits and 4096 divides 65536, so masking here changes nothing else
+    pcRegister &= FIRST_TWELVE_BITS;
+    indexRegister &= FIRST_TWELVE_BITS;
+
+    //Earlier snapshots no longer describe this memory
+    snapshotBase.reset();
+    snapshotDirtyPages = ~0ULL;
+    return true;
+}
+
+/**
+ * @brief Fetch, decode and execute a single instruction.
+ * The instruction comes pre-decoded from decodeCache unless its page has been written since LoadROM.
+ * The PC is advanced past the instruction before it executes, 
+ * so jumps, calls and skips work relative to the next instruction.
+ * 
+ * @effects ins and opcode by setting to the instruction at pcRegister
+ * @effects pcRegister by incrementing by 2, then whatever the instruction does
+ * @effects cycleCount by incrementing
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::Cycle()
+{
+    uint16_t address = pcRegister & FIRST_TWELVE_BITS;
+
+    //Odd addresses and pages written since the cache was built are decoded from memory
+    if (((address | (modifiedPages >> (address >> 6U))) & 1U) == 0)
+    {
+        ins = decodeCache->slots[address >> 1U];
+    } else
+    {
+        ins = Decode(FetchOpcode(address));
+    }
+
+    opcode = ins.opcode;
+    pcRegister += 2;
+    cycleCount++;
+
+    Chip8Func handler = handlers[ins.handler];
+    (this->*handler)();
+}
+
+/**
+ * @brief Execute a fixed number of instructions.
+ * 
+ * @param cycles number of instructions to execute
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::Run(uint32_t cycles)
+{
+    if (executionMode == ExecutionMode::Threaded)
+    {
+        RunThreaded(cycles);
+        return;
+    }
+
+    while (cycles--)
+    {
+        Cycle();
+    }
+}
+
+/**
+ * @brief Execute a fixed number of instructions a basic block at a time.
+ * A block is a straight run of cached instructions ending at a branch, skip, call, return or memory write, 
+ * so the instructions inside it run back to back without checking the cache or the PC. 
+ * Blocks touching a page written since LoadROM, and odd PCs, fall back to Cycle().
+ * 
+ * @param cycles number of instructions to execute
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::RunThreaded(uint32_t cycles)
+{
+    while (cycles > 0)
+    {
+        uint16_t address = pcRegister & FIRST_TWELVE_BITS;
+
+        //A block is at most 64 bytes long, so it can only reach into the following page
+        uint64_t pages = modifiedPages >> (address >> 6U);
+        if (((address | pages | (pages >> 1U)) & 1U) != 0)
+        {
+            Cycle();
+            cycles--;
+            continue;
+        }
+
+        const DecodedInstruction* block = &decodeCache->slots[address >> 1U];
+        uint32_t length = block->blockLength < cycles ? block->blockLength : cycles;
+        cycles -= length;
+        cycleCount += length;
+
+        for (const DecodedInstruction* next = block; next != block + length; next++)
+        {
+            ins = *next;
+            pcRegister += 2;
+            Chip8Func handler = handlers[ins.handler];
+            (this->*handler)();
+        }
+
+        opcode = ins.opcode;
+    }
+}
+
+/**
+ * @brief Count both 60 Hz timers down by one, stopping at zero.
+ * Called by the Scheduler once per frame.
+ * 
+ * @effects timer and soundTimer by decrementing if they are above zero
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::TickTimers()
+{
+    if (timer > 0)
+    {
+        timer--;
+    }
+
+    if (soundTimer > 0)
+    {
+        soundTimer--;
+    }
+}
+
+/**
+ * @brief Recognise a loop that spins reading the delay timer until it reaches zero, 
+ * when the PC is anywhere inside it:
+ *   head: LD Vx, DT     head: LD Vx, DT
+ *         SE Vx, 0            SNE Vx, 0
+ *         JP head             JP exit
+ *                             JP head
+ * 
+ * @param head set to the address of the loop's LD Vx, DT
+ * @param Vx set to the register the loop reads the timer into
+ * @return true if the machine will keep spinning until the next timer tick
+ */
+template <typename Quirks>
+bool Chip8Core<Quirks>::FindTimerSpin(uint16_t& head, uint8_t& Vx) const
+{
+    if (timer == 0)
+    {
+        return false;
+    }
+
+    uint16_t address = pcRegister & FIRST_TWELVE_BITS;
+    const uint16_t offsets[] = {0, 2, 4, 6};
+    for (uint16_t offset : offsets)
+    {
+        uint16_t start = (address - offset) & FIRST_TWELVE_BITS;
+        uint16_t load = FetchOpcode(start);
+        uint16_t test = FetchOpcode(start + 2);
+        uint8_t x = (load & 0x0F00U) >> 8U;
+        if ((load & 0xF0FFU) != 0xF007U || (test & 0x0FFFU) != (static_cast<unsigned int>(x) << 8U))
+        {
+            continue;
+        }
+
+        //Until the first LD Vx, DT runs, Vx may not hold the timer yet
+        if (offset != 0 && registers[x] != timer)
+        {
+            continue;
+        }
+
+        bool equalLoop = (test >> 12U) == 0x3U && offset <= 4 && FetchOpcode(start + 4) == (0x1000U | start);
+        bool notEqualLoop = (test >> 12U) == 0x4U && offset != 4 && (FetchOpcode(start + 4) >> 12U) == 0x1U
+                && FetchOpcode(start + 6) == (0x1000U | start);
+        if (equalLoop || notEqualLoop)
+        {
+            head = start;
+            Vx = x;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Whether the machine is stuck until something outside the CPU changes: 
+ * spinning on the delay timer, waiting in FX0A with no key down, jumping to itself, or stopped by SUPER-CHIP EXIT.
+ * 
+ * @return what the machine is waiting for
+ */
+template <typename Quirks>
+IdleState Chip8Core<Quirks>::DetectIdle() const
+{
+    uint16_t address = pcRegister & FIRST_TWELVE_BITS;
+    uint16_t op = FetchOpcode(address);
+
+    if ((op & 0xF0FFU) == 0xF00AU)
+    {
+        for (uint8_t key = 0; key < 16; key++)
+        {
+            if (keypad[key])
+            {
+                return IdleState::Running;
+            }
+        }
+        return IdleState::WaitingForKey;
+    }
+
+    if (op == (0x1000U | address) || (Quirks::superChip && op == 0x00FDU))
+    {
+        return IdleState::WaitingForTimer;
+    }
+
+    uint16_t head;
+    uint8_t Vx;
+    return FindTimerSpin(head, Vx) ? IdleState::WaitingForTimer : IdleState::Running;
+}
+
+/**
+ * @brief Skip an idle machine ahead to a later instruction count, 
+ * leaving it as it would be at the top of its wait loop.
+ * Only valid while DetectIdle() reports the machine is waiting, and only up to the next timer tick 
+ * or input change, since until then every iteration of the loop is identical.
+ * 
+ * @param cycle cycleCount to skip to
+ * @effects cycleCount by setting to cycle
+ * @effects pcRegister and the loop's register as the timer loop leaves them at its head
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::FastForward(uint64_t cycle)
+{
+    uint16_t head;
+    uint8_t Vx;
+    if (FindTimerSpin(head, Vx))
+    {
+        pcRegister = head;
+        registers[Vx] = timer;
+    }
+
+    if (cycle > cycleCount)
+    {
+        cycleCount = cycle;
+    }
+}
+
+/**
+ * @brief Cycle() lands here for opcodes the interpreter does not implement.
+ * 
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_NULL()
+{
+}
+
+/**
+ * @brief XOR sprite words into consecutive display words, one 128 pixel row per SIMD operation where available.
+ * 
+ * @param rows first display word to draw into
+ * @param sprite sprite words, already shifted into position
+ * @param count number of words to draw
+ * @effects rows by XORing with the matching sprite word
+ * @return true if any pixel set in both a word and its sprite word was erased
+ */
+static bool BlitRows(uint64_t* rows, const uint64_t* sprite, unsigned int count)
+{
+    unsigned int row = 0;
+    uint64_t collision = 0;
+
+#if defined(CHIP8_BLIT_SSE2)
+    __m128i hits = _mm_setzero_si128();
+    for (; row + 2 <= count; row += 2)
+    {
+        __m128i screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + row));
+        __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sprite + row));
+        hits = _mm_or_si128(hits, _mm_and_si128(screen, bits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rows + row), _mm_xor_si128(screen, bits));
+    }
+    collision = _mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128())) != 0xFFFF;
+#elif defined(CHIP8_BLIT_NEON)
+    uint64x2_t hits = vdupq_n_u64(0);
+    for (; row + 2 <= count; row += 2)
+    {
+        uint64x2_t screen = vld1q_u64(rows + row);
+        uint64x2_t bits = vld1q_u64(sprite + row);
+        hits = vorrq_u64(hits, vandq_u64(screen, bits));
+        vst1q_u64(rows + row, veorq_u64(screen, bits));
+    }
+    collision = vgetq_lane_u64(hits, 0) | vgetq_lane_u64(hits, 1);
+#endif
+
+    for (; row < count; row++)
+    {
+        collision |= rows[row] & sprite[row];
+        rows[row] ^= sprite[row];
+    }
 
-uint8_t fontset[FONTSET_SIZE] =
-{
-	0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
-	0x20, 0x60, 0x20, 0x20, 0x70, // 1
-	0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
-	0xF0, 0x10, 0xF0, 0x10, 0xF0, // 3
-	0x90, 0x90, 0xF0, 0x10, 0x10, // 4
-	0xF0, 0x80, 0xF0, 0x10, 0xF0, // 5
-	0xF0, 0x80, 0xF0, 0x90, 0xF0, // 6
-	0xF0, 0x10, 0x20, 0x40, 0x40, // 7
-	0xF0, 0x90, 0xF0, 0x90, 0xF0, // 8
-	0xF0, 0x90, 0xF0, 0x10, 0xF0, // 9
-	0xF0, 0x90, 0xF0, 0x90, 0x90, // A
-	0xE0, 0x90, 0xE0, 0x90, 0xE0, // B
-	0xF0, 0x80, 0x80, 0x80, 0xF0, // C
-	0xE0, 0x90, 0x90, 0x90, 0xE0, // D
-	0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
-	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
-};
+    return collision != 0;
+}
 
-Chip8::Chip8()
-        : randGen(std::chrono::system_clock::now().time_since_epoch().count())
+/**
+ * @brief Record that display rows changed, for DirtyRows() and DisplayGeneration().
+ * 
+ * @param rows mask of the rows that changed, nothing is recorded if it is 0
+ * @effects dirtyRows and displayGeneration
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::DisplayChanged(uint64_t rows)
 {
-    
-    
-    //Set initial PC address
-    pcRegister = START_ADDRESS;
+    if (rows != 0)
+    {
+        dirtyRows |= rows;
+        displayGeneration++;
+    }
+}
 
-    //Initialize fonts into memory
-    for (int i = 0; i < FONTSET_SIZE; i++)
+/**
+ * @brief Turn every pixel off, in both resolutions.
+ * 
+ * @effects display by setting all entries to 0
+ * @effects dirtyRows and displayGeneration for the rows that had lit pixels
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::ClearDisplay()
+{
+    uint64_t litRows = 0;
+    for (unsigned int row = 0; row < DISPLAY_ROWS; row++)
     {
-        memory[FONT_ADDRESS + i] = fontset[i];
+        uint64_t lit = 0;
+        for (unsigned int word = 0; word < ROW_WORDS; word++)
+        {
+            lit |= display[row][word];
+        }
+        litRows |= static_cast<uint64_t>(lit != 0) << row;
     }
 
-    //Generate a random int between 0 to 255 inclusive
-    randByte = std::uniform_int_distribution<uint8_t>(0, 255U);
+    memset(display, 0, sizeof(display));
+    DisplayChanged(litRows);
 }
 
-void Chip8::LoadROM(char const* filename)
+/**
+ * @brief XOR a sprite read from memory at I onto the display, the kernel behind DXYN in both resolutions.
+ * Each sprite row is shifted into a whole display row at once, two words in SUPER-CHIP variants, 
+ * and pixels past the right edge of the current resolution are dropped, so one BlitRows covers the whole sprite.
+ * The start position wraps around the screen, pixels past the right or bottom edge are clipped.
+ * 
+ * @param x column of the sprite's left edge
+ * @param y row of the sprite's top edge
+ * @param height number of sprite rows, at most 16
+ * @param width 8, or 16 for SUPER-CHIP large sprites stored as two bytes per row
+ * @effects display by XORing each sprite row into its row
+ * @effects dirtyRows and displayGeneration if any row changed
+ * @effects registers[REGISTER_VF] by setting to 1 if any lit pixel was erased and 0 otherwise
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::DrawSprite(uint8_t x, uint8_t y, unsigned int height, unsigned int width)
 {
-    std::ifstream rom(filename, std::ifstream::binary | std::ios::ate);
-    if (rom.is_open())
+    unsigned int xPos = x & (DisplayWidth() - 1);
+    unsigned int yPos = y & (DisplayHeight() - 1);
+    if (yPos + height > DisplayHeight())
     {
-        //Read contents to memory
-        std::streampos size = rom.tellg();
-        char* buffer = new char[size];
+        height = DisplayHeight() - yPos;
+    }
+
+    //Only high resolution has pixels in the second word of a row
+    uint64_t secondWord = highResolution ? ~0ULL : 0;
+    unsigned int bytesPerRow = width / 8;
 
-        //Return to start of file and fill buffer
-        rom.seekg(0, std::ios_base::beg);
-        rom.read(buffer, size);
-        rom.close();
+    uint64_t sprite[16][ROW_WORDS]{};
+    uint64_t changedRows = 0;
+    for (unsigned int row = 0; row < height; row++)
+    {
+        uint64_t bits = memory[(indexRegister + row * bytesPerRow) & FIRST_TWELVE_BITS];
+        if (bytesPerRow == 2)
+        {
+            bits = (bits << 8U) | memory[(indexRegister + row * 2 + 1) & FIRST_TWELVE_BITS];
+        }
+        bits <<= 64 - width;
 
-        // Read contents from buffer into memory
-        for (long i = 0; i < size; i++)
+        sprite[row][0] = xPos < 64 ? bits >> xPos : 0;
+        uint64_t drawn = sprite[row][0];
+        if constexpr (ROW_WORDS == 2)
         {
-            memory[START_ADDRESS + i] = buffer[i];
+            if (xPos < 64)
+            {
+                sprite[row][1] = xPos == 0 ? 0 : (bits << (64 - xPos)) & secondWord;
+            } else
+            {
+                sprite[row][1] = bits >> (xPos - 64);
+            }
+            drawn |= sprite[row][1];
         }
 
-        // Free space
-        delete[] buffer;
+        if (drawn != 0)
+        {
+            changedRows |= 1ULL << (yPos + row);
+        }
     }
-    
+
+    registers[REGISTER_VF] = BlitRows(display[yPos], sprite[0], height * ROW_WORDS) ? 1 : 0;
+    DisplayChanged(changedRows);
+}
+
+/**
+ * @brief Unpack the 1-bit display into 32-bit pixels for a frontend, 
+ * row by row from the top left corner.
+ * 
+ * @param pixels buffer of at least DisplayWidth() * DisplayHeight() pixels to write into
+ * @param onColour colour of lit pixels
+ * @param offColour colour of unlit pixels
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::ExpandDisplay(uint32_t* pixels, uint32_t onColour, uint32_t offColour) const
+{
+    unsigned int words = DisplayWidth() / 64;
+    for (unsigned int y = 0; y < DisplayHeight(); y++)
+    {
+        for (unsigned int word = 0; word < words; word++)
+        {
+            uint64_t row = display[y][word];
+            for (unsigned int x = 0; x < 64; x++)
+            {
+                *pixels++ = ((row << x) & LEFTMOST_PIXEL) ? onColour : offColour;
+            }
+        }
+    }
+}
+
+template <typename Quirks>
+unsigned int Chip8Core<Quirks>::DisplayWidth() const
+{
+    return highResolution ? HIRES_WIDTH : VIDEO_WIDTH;
+}
+
+template <typename Quirks>
+unsigned int Chip8Core<Quirks>::DisplayHeight() const
+{
+    return highResolution ? HIRES_HEIGHT : VIDEO_HEIGHT;
+}
+
+/**
+ * @brief Rows of display changed by drawing, clearing or scrolling since the last ClearDirtyRows(), 
+ * so a frontend only has to upload those rows.
+ * 
+ * @return mask with bit n set if row n changed
+ */
+template <typename Quirks>
+uint64_t Chip8Core<Quirks>::DirtyRows() const
+{
+    return dirtyRows;
+}
+
+/**
+ * @brief Mark every row of display as seen by the frontend.
+ * 
+ * @effects dirtyRows by clearing all bits
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::ClearDirtyRows()
+{
+    dirtyRows = 0;
+}
+
+/**
+ * @brief A counter that increases every time display changes, 
+ * so consumers can detect a new frame with a single comparison.
+ * 
+ * @return number of display changes since construction
+ */
+template <typename Quirks>
+uint64_t Chip8Core<Quirks>::DisplayGeneration() const
+{
+    return displayGeneration;
 }
 
 /**
  * @brief (CLS) Clear the display.
  * 
  * @effects Display by setting all entries to 0.
+ * @effects dirtyRows and displayGeneration for the rows that had lit pixels
  * 
  */
-void Chip8::OP_00E0()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00E0()
 {
-    memset(display, 0, sizeof(display));
+    ClearDisplay();
 }
 
 /**
  * @brief (RET) Return from a subroutine.
  * The interpreter sets the program counter to the address at the top of the stack, 
- * then subtracts 1 from the stack pointer.
+ * then subtracts 1 from the stack pointer, wrapping within the 16 entries so a stray return stays inside the stack.
  * 
  * @effects Sets pcRegister to top of stack
  */
-void Chip8::OP_00EE()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00EE()
+{
+    pcRegister = stack[sp & 0x0FU];
+    sp = (sp - 1U) & 0x0FU;
+}
+
+/**
+ * @brief (SCD nibble) Scroll the display down n rows, SUPER-CHIP.
+ * Rows are moved whole; the n rows at the top are cleared. 
+ * Scrolls are in pixels of the current resolution.
+ * 
+ * @effects display by moving every row down n rows
+ * @effects dirtyRows and displayGeneration for every row, if anything was lit
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00CN()
+{
+    if constexpr (Quirks::superChip)
+    {
+        unsigned int height = DisplayHeight();
+        unsigned int rows = ins.n;
+        uint64_t lit = 0;
+        for (unsigned int row = 0; row < height; row++)
+        {
+            lit |= display[row][0] | display[row][1];
+        }
+
+        memmove(display[rows], display[0], (height - rows) * sizeof(display[0]));
+        memset(display[0], 0, rows * sizeof(display[0]));
+        DisplayChanged(lit != 0 && rows != 0 ? ~0ULL >> (64 - height) : 0);
+    }
+}
+
+/**
+ * @brief (SCR) Scroll the display right 4 pixels, SUPER-CHIP.
+ * Each row shifts as one 128 bit value, carrying from its first word into its second.
+ * 
+ * @effects display by shifting every row right 4 pixels
+ * @effects dirtyRows and displayGeneration for the rows that had lit pixels
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00FB()
+{
+    if constexpr (Quirks::superChip)
+    {
+        uint64_t secondWord = highResolution ? ~0ULL : 0;
+        uint64_t litRows = 0;
+        for (unsigned int row = 0; row < DisplayHeight(); row++)
+        {
+            uint64_t left = display[row][0];
+            uint64_t right = display[row][1];
+            display[row][0] = left >> SCROLL_PIXELS;
+            display[row][1] = ((right >> SCROLL_PIXELS) | (left << (64 - SCROLL_PIXELS))) & secondWord;
+            litRows |= static_cast<uint64_t>((left | right) != 0) << row;
+        }
+        DisplayChanged(litRows);
+    }
+}
+
+/**
+ * @brief (SCL) Scroll the display left 4 pixels, SUPER-CHIP.
+ * Each row shifts as one 128 bit value, carrying from its second word into its first.
+ * 
+ * @effects display by shifting every row left 4 pixels
+ * @effects dirtyRows and displayGeneration for the rows that had lit pixels
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00FC()
+{
+    if constexpr (Quirks::superChip)
+    {
+        uint64_t litRows = 0;
+        for (unsigned int row = 0; row < DisplayHeight(); row++)
+        {
+            uint64_t left = display[row][0];
+            uint64_t right = display[row][1];
+            display[row][0] = (left << SCROLL_PIXELS) | (right >> (64 - SCROLL_PIXELS));
+            display[row][1] = right << SCROLL_PIXELS;
+            litRows |= static_cast<uint64_t>((left | right) != 0) << row;
+        }
+        DisplayChanged(litRows);
+    }
+}
+
+/**
+ * @brief (EXIT) Stop the interpreter, SUPER-CHIP.
+ * The machine stays on this instruction until a new ROM is loaded.
+ * 
+ * @effects pcRegister by moving back onto this instruction
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00FD()
+{
+    if constexpr (Quirks::superChip)
+    {
+        pcRegister -= 2;
+    }
+}
+
+/**
+ * @brief (LOW) Switch to 64 * 32 resolution, SUPER-CHIP.
+ * 
+ * @effects highResolution by clearing
+ * @effects display by clearing, as switching resolution does
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00FE()
+{
+    if constexpr (Quirks::superChip)
+    {
+        highResolution = false;
+        ClearDisplay();
+    }
+}
+
+/**
+ * @brief (HIGH) Switch to 128 * 64 resolution, SUPER-CHIP.
+ * 
+ * @effects highResolution by setting
+ * @effects display by clearing, as switching resolution does
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_00FF()
 {
-    pcRegister = stack[sp--];
+    if constexpr (Quirks::superChip)
+    {
+        highResolution = true;
+        ClearDisplay();
+    }
 }
 
 /**
@@ -112,24 +1644,28 @@ void Chip8::OP_00EE()
  * 
  * @effects sets pcRegister to opcode & b.1111.1111.1111
  */
-void Chip8::OP_1NNN()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_1NNN()
 {
-    pcRegister = opcode & FIRST_TWELVE_BITS; //opcode & b.1111.1111.1111
+    pcRegister = ins.nnn; //opcode & b.1111.1111.1111
 }
 
 /**
  * @brief Call subroutine at nnn.
  * The interpreter increments the stack pointer, 
  * then puts the current PC on the top of the stack. 
- * The PC is then set to nnn.
+ * The PC is then set to nnn. Calls nested too deep wrap around the 16 entries 
+ * instead of overwriting whatever follows the stack.
  * 
  * @effects stack by setting top of stack equal to PC
  * @effects pcRegister by equaling opcode & b.1111.1111.1111
  */
-void Chip8::OP_2NNN()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_2NNN()
 {
-    stack[++sp] = pcRegister;
-    pcRegister = opcode & FIRST_TWELVE_BITS; //opcode & b.1111.1111.1111
+    sp = (sp + 1U) & 0x0FU;
+    stack[sp] = pcRegister;
+    pcRegister = ins.nnn; //opcode & b.1111.1111.1111
 }
 
 /**
@@ -139,10 +1675,11 @@ void Chip8::OP_2NNN()
  * 
  * @effects pcRegister by incrementing by 2 if registers[Vx] == kk
  */
-void Chip8::OP_3XKK()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_3XKK()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t byte = 0x0FFU & opcode;
+    uint8_t Vx = ins.x;
+    uint8_t byte = ins.kk;
     if (registers[Vx] == byte)
     {
         pcRegister += 2; //skip instruction
@@ -156,10 +1693,11 @@ void Chip8::OP_3XKK()
  * 
  * @effects pcRegister by incrementing by 2 if registers[Vx] != kk
  */
-void Chip8::OP_4XKK()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_4XKK()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t byte = 0x0FFU & opcode;
+    uint8_t Vx = ins.x;
+    uint8_t byte = ins.kk;
     if (registers[Vx] != byte)
     {
         pcRegister += 2; //skip instruction
@@ -173,15 +1711,16 @@ void Chip8::OP_4XKK()
  * 
  * @effects pcRegister by incrementing by 2 if registers[Vx] == registers[Vy]
  */
-void Chip8::OP_5XY0()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_5XY0()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
-    if (Vx == Vy)
-        {
-            pcRegister += 2; //skip instruction
-        }
+    if (registers[Vx] == registers[Vy])
+    {
+        pcRegister += 2; //skip instruction
+    }
 }
 
 /**
@@ -190,10 +1729,11 @@ void Chip8::OP_5XY0()
  * 
  * @effects registers[Vx] by setting = kk
  */
-void Chip8::OP_6XKK()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_6XKK()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t byte = opcode & 0x00FFU;
+    uint8_t Vx = ins.x;
+    uint8_t byte = ins.kk;
     registers[Vx] = byte;
 }
 
@@ -203,10 +1743,11 @@ void Chip8::OP_6XKK()
  * 
  * @effects registers[Vx] by adding kk to it
  */
-void Chip8::OP_7XKK()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_7XKK()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t byte = opcode & 0x00FFU;
+    uint8_t Vx = ins.x;
+    uint8_t byte = ins.kk;
 
     registers[Vx] += byte;
 }
@@ -217,10 +1758,11 @@ void Chip8::OP_7XKK()
  * 
  * @effects registers[Vx] by setting equal to registers[Vy]
  */
-void Chip8::OP_8XY0()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY0()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
     registers[Vx] = registers[Vy];
 }
@@ -233,13 +1775,20 @@ void Chip8::OP_8XY0()
  * Otherwise, it is 0.
  * 
  * @effects registers[Vx] by ORing with registers[Vy]
+ * @effects registers[REGISTER_VF] by clearing, in variants with logicResetsVF
  */
-void Chip8::OP_8XY1()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY1()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
     
     registers[Vx] |= registers[Vy];
+
+    if constexpr (Quirks::logicResetsVF)
+    {
+        registers[REGISTER_VF] = 0;
+    }
 }
 
 /**
@@ -250,13 +1799,20 @@ void Chip8::OP_8XY1()
  * Otherwise, it is 0.
  * 
  * @effects registers[Vx] by ANDing with registers[Vy]
+ * @effects registers[REGISTER_VF] by clearing, in variants with logicResetsVF
  */
-void Chip8::OP_8XY2()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY2()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
     registers[Vx] &= registers[Vy];
+
+    if constexpr (Quirks::logicResetsVF)
+    {
+        registers[REGISTER_VF] = 0;
+    }
 }
 
 /**
@@ -267,13 +1823,20 @@ void Chip8::OP_8XY2()
  * Otherwise, it is 0.
  * 
  * @effects registers[Vx] by XORing with registers[Vy]
+ * @effects registers[REGISTER_VF] by clearing, in variants with logicResetsVF
  */
-void Chip8::OP_8XY3()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY3()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
     registers[Vx] ^= registers[Vy];
+
+    if constexpr (Quirks::logicResetsVF)
+    {
+        registers[REGISTER_VF] = 0;
+    }
 }
 
 /**
@@ -285,23 +1848,16 @@ void Chip8::OP_8XY3()
  * @effects registers[REGISTER_VF] by setting to 1 if registers[Vx] + registers[Vy] > 255 and 0 otherwise
  * @effects registers[Vx] by equaling sum of registers[Vx] and registers[Vy]
  */
-void Chip8::OP_8XY4()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY4()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
     
     uint16_t sum = registers[Vx] + registers[Vy];
-    
-    if (sum > 0x00FFU)
-    {
-        registers[REGISTER_VF] = 1;
-    } else
-    {
-        registers[REGISTER_VF] = 0;
-    }
 
-    registers[Vx] = sum & 0x00FFU; 
-    
+    registers[Vx] = sum & 0x00FFU;
+    registers[REGISTER_VF] = sum > 0x00FFU ? 1 : 0; //flag last, so 8FY4 leaves the carry in VF
 }
 
 /**
@@ -312,38 +1868,36 @@ void Chip8::OP_8XY4()
  * @effects registers[REGISTER_VF] by setting to 1 if registers[Vx] > registers[Vy] and 0 otherwise
  * @effects registers[Vx] by minusing registers[Vy] from registers[Vx]
  */
-void Chip8::OP_8XY5()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY5()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
-    if (registers[Vx] > registers[Vy])
-    {
-        registers[REGISTER_VF] = 1;
-    } else
-    {
-        registers[REGISTER_VF] = 0;
-    }
+    uint8_t notBorrow = registers[Vx] > registers[Vy] ? 1 : 0;
 
     registers[Vx] -= registers[Vy];
+    registers[REGISTER_VF] = notBorrow; //flag last, so 8FY5 leaves it in VF
 }
 
 /**
  * @brief Set Vx = Vx SHR 1.
  * If the least-significant bit of Vx is 1, then VF is set to 1, otherwise 0. Then Vx is divided by 2.
  * 
- * @effects registers[REGISTER_VF] by setting to the least significant bit of registers[Vx]
- * @effects registers[Vx] by shifting right by 1 bit
+ * Variants with shiftUsesVy shift Vy instead and store the result in Vx.
+ * 
+ * @effects registers[REGISTER_VF] by setting to the least significant bit of the shifted register
+ * @effects registers[Vx] by setting to the shifted register shifted right by 1 bit
  */
-void Chip8::OP_8XY6()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY6()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t LSB = registers[Vx] & 1;
-
-    registers[REGISTER_VF] = LSB;
+    uint8_t Vx = ins.x;
+    uint8_t value = Quirks::shiftUsesVy ? registers[ins.y] : registers[Vx];
+    uint8_t LSB = value & 1;
 
-    registers[Vx] >>= 1U;
-    
+    registers[Vx] = value >> 1U;
+    registers[REGISTER_VF] = LSB; //flag last, so 8FY6 leaves the shifted out bit in VF
 }
 
 /**
@@ -354,20 +1908,16 @@ void Chip8::OP_8XY6()
  * @effects registers[REGISTER_VF] by setting to 1 if registers[Vy] > registers[Vx], 0 otherwise
  * @effects registers[Vx] by setting to registers[Vy] - registers[Vx]
  */
-void Chip8::OP_8XY7()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XY7()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
-    if (registers[Vy] > registers[Vx])
-    {
-        registers[REGISTER_VF] = 1;
-    } else
-    {
-        registers[REGISTER_VF] = 0;
-    }
+    uint8_t notBorrow = registers[Vy] > registers[Vx] ? 1 : 0;
 
     registers[Vx] = registers[Vy] - registers[Vx];
+    registers[REGISTER_VF] = notBorrow; //flag last, so 8FY7 leaves it in VF
 }
 
 /**
@@ -375,18 +1925,20 @@ void Chip8::OP_8XY7()
  * If the most-significant bit of Vx is 1, then VF is set to 1, otherwise to 0. 
  * Then Vx is multiplied by 2.
  * 
- * @effects registers[REGISTER_VF] by setting to the most significant bit of registers[Vx]
- * @effects registers[Vx] by shifting left by 1 bit
+ * Variants with shiftUsesVy shift Vy instead and store the result in Vx.
+ * 
+ * @effects registers[REGISTER_VF] by setting to the most significant bit of the shifted register
+ * @effects registers[Vx] by setting to the shifted register shifted left by 1 bit
  */
-void Chip8::OP_8XYE()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_8XYE()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t MSB = (registers[Vx] & 0x80U) >> 7U;
-
-    registers[REGISTER_VF] = MSB;
+    uint8_t Vx = ins.x;
+    uint8_t value = Quirks::shiftUsesVy ? registers[ins.y] : registers[Vx];
+    uint8_t MSB = (value & 0x80U) >> 7U;
 
-    registers[Vx] <<= 1;
-    
+    registers[Vx] = static_cast<uint8_t>(value << 1U);
+    registers[REGISTER_VF] = MSB; //flag last, so 8FYE leaves the shifted out bit in VF
 }
 
 /**
@@ -396,10 +1948,11 @@ void Chip8::OP_8XYE()
  * 
  * @effects pcRegister by incrementing by 2 if registers[Vx] != registers[Vy]
  */
-void Chip8::OP_9XY0()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_9XY0()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t Vy = (0x00F0U & opcode) >> 4U;
+    uint8_t Vx = ins.x;
+    uint8_t Vy = ins.y;
 
     if (registers[Vx] != registers[Vy])
     {
@@ -413,20 +1966,22 @@ void Chip8::OP_9XY0()
  * 
  * @effects indexRegister by setting to opcode & b.1111.1111.1111
  */
-void Chip8::OP_ANNN()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_ANNN()
 {
-    indexRegister = opcode & 0x0FFFU;
+    indexRegister = ins.nnn;
 }
 
 /**
  * @brief Jump to location nnn + V0.
- * The program counter is set to nnn plus the value of V0.
+ * The program counter is set to nnn plus the value of V0, or of Vx in variants with jumpUsesVx.
  * 
  * @effects pcRegister by setting to registers[REGISTER_V0] + (opcode & b.1111.1111.1111)
  */
-void Chip8::OP_BNNN()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_BNNN()
 {
-    pcRegister = registers[REGISTER_V0] + (opcode & 0x0FFFU);
+    pcRegister = registers[Quirks::jumpUsesVx ? ins.x : REGISTER_V0] + ins.nnn;
 }
 
 /**
@@ -436,27 +1991,75 @@ void Chip8::OP_BNNN()
  * 
  * @effects registers[Vx] by setting to kk ANDed with a random number between 0 to 255
  */
-void Chip8::OP_CXKK()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_CXKK()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
-    uint8_t byte = opcode & 0x00FFU;
+    uint8_t Vx = ins.x;
+    uint8_t byte = ins.kk;
 
-    registers[Vx] = byte & randByte(randGen);
+    uint8_t random = randomSource ? randomSource(randomContext) : static_cast<uint8_t>(rng.Next() >> 24U);
+    registers[Vx] = byte & random;
 }
 
-void Chip8::OP_DXYN()
+/**
+ * @brief Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+ * The interpreter reads n bytes from memory, starting at the address stored in I. 
+ * These bytes are then displayed as sprites on screen at coordinates (Vx, Vy). 
+ * Sprites are XORed onto the existing screen. If this causes any pixels to be erased, 
+ * VF is set to 1, otherwise it is set to 0. The start position wraps around the screen, 
+ * pixels past the right or bottom edge are clipped. 
+ * SUPER-CHIP variants draw a 16 * 16 sprite of two bytes per row when n is 0.
+ * 
+ * @effects display by XORing each sprite row into its row
+ * @effects dirtyRows and displayGeneration if any row changed
+ * @effects registers[REGISTER_VF] by setting to 1 if any lit pixel was erased and 0 otherwise
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_DXYN()
 {
-    //TODO: add this draw instruction
+    if (Quirks::superChip && ins.n == 0)
+    {
+        DrawSprite(registers[ins.x], registers[ins.y], 16, 16);
+    } else
+    {
+        DrawSprite(registers[ins.x], registers[ins.y], ins.n, 8);
+    }
 }
 
-void Chip8::OP_EX9E()
+/**
+ * @brief Skip next instruction if key with the value of Vx is pressed.
+ * Checks the keyboard, and if the key corresponding to the value of Vx is currently in the down position, 
+ * PC is increased by 2.
+ * 
+ * @effects pcRegister by incrementing by 2 if keypad[registers[Vx]] is pressed
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_EX9E()
 {
-    //TODO: add this
+    uint8_t Vx = ins.x;
+
+    if (keypad[registers[Vx] & 0x0FU])
+    {
+        pcRegister += 2;
+    }
 }
 
-void Chip8::OP_EXA1()
+/**
+ * @brief Skip next instruction if key with the value of Vx is not pressed.
+ * Checks the keyboard, and if the key corresponding to the value of Vx is currently in the up position, 
+ * PC is increased by 2.
+ * 
+ * @effects pcRegister by incrementing by 2 if keypad[registers[Vx]] is not pressed
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_EXA1()
 {
-    //TODO: add this
+    uint8_t Vx = ins.x;
+
+    if (!keypad[registers[Vx] & 0x0FU])
+    {
+        pcRegister += 2;
+    }
 }
 
 /**
@@ -465,16 +2068,37 @@ void Chip8::OP_EXA1()
  * 
  * @effects registers[Vx] by setting to the value of the 60 Hz delay timer
  */
-void Chip8::OP_FX07()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX07()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
+    uint8_t Vx = ins.x;
     
     registers[Vx] = timer;
 }
 
-void Chip8::OP_FX0A()
+/**
+ * @brief Wait for a key press, store the value of the key in Vx.
+ * All execution stops until a key is pressed, then the value of that key is stored in Vx. 
+ * Waiting is done by repeating this instruction, so timers keep running.
+ * 
+ * @effects registers[Vx] by setting to the lowest pressed key
+ * @effects pcRegister by moving back to this instruction while no key is pressed
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX0A()
 {
-    //TODO: add this
+    uint8_t Vx = ins.x;
+
+    for (uint8_t key = 0; key < 16; key++)
+    {
+        if (keypad[key])
+        {
+            registers[Vx] = key;
+            return;
+        }
+    }
+
+    pcRegister -= 2;
 }
 
 /**
@@ -483,9 +2107,10 @@ void Chip8::OP_FX0A()
  * 
  * @effects timer by setting to registers[Vx]
  */
-void Chip8::OP_FX15()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX15()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
+    uint8_t Vx = ins.x;
     
     timer = registers[Vx];
 }
@@ -496,9 +2121,10 @@ void Chip8::OP_FX15()
  * 
  * @effects soundTimer by setting equal to registers[Vx]
  */
-void Chip8::OP_FX18()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX18()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
+    uint8_t Vx = ins.x;
 
     soundTimer = registers[Vx];
 }
@@ -509,29 +2135,133 @@ void Chip8::OP_FX18()
  * 
  * @effects indexRegister by adding registers[Vx]
  */
-void Chip8::OP_FX1E()
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX1E()
 {
-    uint8_t Vx = (0x0F00U & opcode) >> 8U;
+    uint8_t Vx = ins.x;
 
     indexRegister += registers[Vx];
 }
 
-void Chip8::OP_FX29()
+/**
+ * @brief Set I = location of sprite for digit Vx.
+ * The value of I is set to the location for the hexadecimal sprite corresponding to the low nibble of Vx.
+ * 
+ * @effects indexRegister by setting to the address of the font sprite for registers[Vx]
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX29()
+{
+    indexRegister = FONT_ADDRESS + (registers[ins.x] & 0x0FU) * 5U;
+}
+
+/**
+ * @brief Set I = location of the 8 * 10 sprite for digit Vx, SUPER-CHIP.
+ * 
+ * @effects indexRegister by setting to the address of the large font sprite for registers[Vx]
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX30()
+{
+    if constexpr (Quirks::superChip)
+    {
+        indexRegister = BIG_FONT_ADDRESS + (registers[ins.x] % 10U) * 10U;
+    }
+}
+
+/**
+ * @brief Store BCD representation of Vx in memory locations I, I+1, and I+2.
+ * The interpreter takes the decimal value of Vx, and places the hundreds digit in memory at location in I, 
+ * the tens digit at location I+1, and the ones digit at location I+2.
+ * The digits come from a table of all 256 values rather than division.
+ * 
+ * @effects memory[I], memory[I+1] and memory[I+2] by setting to the digits of registers[Vx]
+ * @effects modifiedPages by marking the written bytes
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX33()
+{
+    uint8_t Vx = ins.x;
+
+    CopyToMemory(memory, indexRegister, bcdTable.digits[registers[Vx]], 3);
+    MarkWritten(indexRegister, 3);
+}
+
+/**
+ * @brief Store registers V0 through Vx in memory starting at location I.
+ * The interpreter copies the values of registers V0 through Vx into memory, starting at the address in I,
+ * as one block move that wraps at the end of memory.
+ * 
+ * @effects memory[I] through memory[I+x] by setting to registers[V0] through registers[Vx]
+ * @effects modifiedPages by marking the written bytes
+ * @effects indexRegister by advancing past the last byte written, if the variant does
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX55()
 {
-    //TODO: add this
+    uint8_t Vx = ins.x;
+
+    CopyToMemory(memory, indexRegister, registers, Vx + 1U);
+    MarkWritten(indexRegister, Vx + 1U);
+
+    if constexpr (Quirks::loadStoreIncrementsI)
+    {
+        indexRegister += Vx + 1U;
+    }
 }
 
-void Chip8::OP_FX33()
+/**
+ * @brief Read registers V0 through Vx from memory starting at location I.
+ * The interpreter reads values from memory starting at location I into registers V0 through Vx,
+ * as one block move that wraps at the end of memory.
+ * 
+ * @effects registers[V0] through registers[Vx] by setting to memory[I] through memory[I+x]
+ * @effects indexRegister by advancing past the last byte read, if the variant does
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX65()
 {
-    //TODO: add this
+    uint8_t Vx = ins.x;
+
+    CopyFromMemory(registers, memory, indexRegister, Vx + 1U);
+
+    if constexpr (Quirks::loadStoreIncrementsI)
+    {
+        indexRegister += Vx + 1U;
+    }
 }
 
-void Chip8::OP_FX55()
+/**
+ * @brief Store registers V0 through Vx in the RPL user flags, SUPER-CHIP.
+ * There are only 8 flags, so x is clamped to 7 and any larger x stores V0 through V7.
+ * 
+ * @effects rplFlags[0] through rplFlags[x] by setting to registers[V0] through registers[Vx]
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX75()
 {
-    //TODO: add this
+    if constexpr (Quirks::superChip)
+    {
+        memcpy(rplFlags, registers, std::min<unsigned int>(ins.x, 7U) + 1U);
+    }
 }
 
-void Chip8::OP_FX65()
+/**
+ * @brief Read registers V0 through Vx from the RPL user flags, SUPER-CHIP.
+ * There are only 8 flags, so x is clamped to 7 and any larger x reads V0 through V7.
+ * 
+ * @effects registers[V0] through registers[Vx] by setting to rplFlags[0] through rplFlags[x]
+ */
+template <typename Quirks>
+void Chip8Core<Quirks>::OP_FX85()
 {
-    //TODO: add this
-}
\ No newline at end of file
+    if constexpr (Quirks::superChip)
+    {
+        memcpy(registers, rplFlags, std::min<unsigned int>(ins.x, 7U) + 1U);
+    }
+}
+
+template class Chip8Core<Chip8Quirks>;
+template class Chip8Core<CosmacQuirks>;
+template class Chip8Core<SuperChipQuirks>;
+template class Chip8Core<XoChipQuirks>;
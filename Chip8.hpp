@@ -1,29 +1,271 @@
+#pragma once
+
 #include <cstdint>
-#include <fstream>
-#include <chrono>
-#include <random>
-#include <stack>
+#include <memory>
+#include <span>
+#include <vector>
+
+// How Run() executes instructions
+enum class ExecutionMode : uint8_t
+{
+    Interpreter, //one Cycle() per instruction
+    Threaded //whole basic blocks from the decode cache, falling back to Cycle()
+};
+
+// An opcode with its operands already extracted
+struct DecodedInstruction
+{
+    uint16_t opcode;
+    uint16_t nnn; //lowest 12 bits
+    uint8_t kk; //lowest 8 bits
+    uint8_t n; //lowest 4 bits
+    uint8_t x; //register index in bits 8 to 11
+    uint8_t y; //register index in bits 4 to 7
+    uint8_t handler; //index of the handler in the opcode table, the same for every variant
+    uint8_t blockLength; //instructions from here to the end of the basic block
+};
+
+// Instructions decoded at every even address of a memory image
+struct DecodedProgram
+{
+    DecodedInstruction slots[4096 / 2];
+};
+
+// ROM bytes and their pre-decoded instructions, shared read-only by every machine running them
+struct RomImage
+{
+    std::span<const uint8_t> bytes;
+    uint64_t hash; //FNV-1a of bytes
+    std::shared_ptr<const DecodedProgram> decoded; //decoding of a freshly booted machine with this ROM loaded
+    std::shared_ptr<const void> storage; //keeps bytes alive
+};
+
+typedef std::shared_ptr<const RomImage> RomHandle;
+
+// PCG32 generator with selectable stream, small and fast enough for RND in tight loops
+struct Pcg32
+{
+    uint64_t state;
+    uint64_t increment; //odd, picks the stream
+
+    void Seed(uint64_t seed, uint64_t stream);
+    uint32_t Next();
+};
+
+// Supplies RND with a random byte
+typedef uint8_t (*RandomSource)(void* context);
+
+// Every part of a machine except memory
+struct MachineState
+{
+    uint8_t registers[16];
+    uint16_t pcRegister;
+    uint16_t indexRegister;
+    uint16_t stack[16];
+    uint8_t sp;
+    uint8_t timer;
+    uint8_t soundTimer;
+    uint8_t keypad[16];
+    uint64_t display[64][2]; //the machine's display rows, packed from the start
+    bool highResolution;
+    uint8_t rplFlags[8];
+    uint64_t dirtyRows;
+    uint64_t displayGeneration;
+    uint64_t cycleCount;
+    Pcg32 rng;
+};
+
+// Full copy of memory that snapshots store their changes against
+struct SnapshotBase
+{
+    uint8_t memory[4096];
+    std::shared_ptr<const DecodedProgram> decodeCache;
+    uint64_t modifiedPages; //pages of memory that differ from decodeCache
+};
 
-class Chip8
+// Machine state plus only the 64 byte pages of memory written since base was taken
+struct Snapshot
+{
+    std::shared_ptr<const SnapshotBase> base;
+    uint64_t pages = 0; //bit n set if page n is stored in pageData
+    std::vector<uint8_t> pageData; //stored pages in ascending order, 64 bytes each
+    MachineState state{}; //padding zeroed, so states can be written out as raw bytes
+};
+
+const uint32_t STATE_MAGIC = 0x53533843U; //"C8SS" in a little endian file, so a file from a big endian host is rejected
+const uint16_t STATE_VERSION = 1;
+
+// First bytes of a state image, checked before anything is restored from it
+struct StateHeader
+{
+    uint32_t magic; //STATE_MAGIC
+    uint16_t version; //STATE_VERSION, bumped whenever the layout changes
+    uint16_t variant; //quirks and display size of the machine that saved it
+    uint32_t imageSize; //sizeof(StateImage)
+    uint32_t reserved; //zero
+};
+
+// Whole machine in a fixed binary layout: a state file is one or more images back to back, 
+// restored straight from a mapping with no parsing. Unused and padding bytes are always zero and 
+// every field sits at the same offset in every image, so batches of images compress well.
+struct StateImage
+{
+    StateHeader header;
+    MachineState state;
+    uint8_t memory[4096];
+};
+
+static_assert(sizeof(StateHeader) == 16, "state header layout changed, bump STATE_VERSION");
+static_assert(sizeof(MachineState) == 1152 && alignof(MachineState) == 8, "machine state layout changed, bump STATE_VERSION");
+static_assert(sizeof(StateImage) == 16 + 1152 + 4096, "state image layout changed, bump STATE_VERSION");
+
+StateImage const* MapStateImage(std::span<const uint8_t> bytes, size_t index = 0); //image in a state file, nullptr if out of range
+bool ValidMachineState(MachineState const& state, uint16_t variant); //false if the state is impossible for the variant, as in a corrupt file
+
+// What, if anything, a machine is stuck waiting for
+enum class IdleState
+{
+    Running,
+    WaitingForTimer, //spinning until the next timer tick
+    WaitingForKey //blocked in FX0A with no key down
+};
+
+// Behaviours that differ between CHIP-8 interpreters, fixed at compile time so each variant
+// gets its own interpreter with no quirk checks left in the handlers
+struct Chip8Quirks //this emulator's original behaviour, which most modern CHIP-8 ROMs expect
+{
+    static constexpr bool shiftUsesVy = false; //8XY6 and 8XYE shift Vy into Vx instead of shifting Vx
+    static constexpr bool jumpUsesVx = false; //BNNN jumps to XNN + Vx instead of NNN + V0
+    static constexpr bool loadStoreIncrementsI = false; //FX55 and FX65 leave I past the last register
+    static constexpr bool logicResetsVF = false; //8XY1, 8XY2 and 8XY3 clear VF
+    static constexpr bool superChip = false; //128 * 64 mode, scrolling, 16 * 16 sprites, big font and RPL flags
+};
+
+struct CosmacQuirks //the original COSMAC VIP interpreter
+{
+    static constexpr bool shiftUsesVy = true;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool loadStoreIncrementsI = true;
+    static constexpr bool logicResetsVF = true;
+    static constexpr bool superChip = false;
+};
+
+struct SuperChipQuirks //SUPER-CHIP 1.1 on the HP 48
+{
+    static constexpr bool shiftUsesVy = false;
+    static constexpr bool jumpUsesVx = true;
+    static constexpr bool loadStoreIncrementsI = false;
+    static constexpr bool logicResetsVF = false;
+    static constexpr bool superChip = true;
+};
+
+struct XoChipQuirks //XO-CHIP as specified for Octo
+{
+    static constexpr bool shiftUsesVy = true;
+    static constexpr bool jumpUsesVx = false;
+    static constexpr bool loadStoreIncrementsI = true;
+    static constexpr bool logicResetsVF = false;
+    static constexpr bool superChip = true;
+};
+
+// Members are laid out hottest first: the registers and decode state every instruction touches 
+// share the first two cache lines, ahead of the display and memory. The display is only as large 
+// as the variant needs, 256 bytes without SUPER-CHIP.
+template <typename Quirks>
+class alignas(64) Chip8Core
 {
 public:
-	Chip8();
-	void LoadROM(char const* filename);
-    uint8_t memory[4096]; //4 kB of memory
+	Chip8Core(); //random numbers seeded from the clock
+    explicit Chip8Core(uint64_t seed, uint64_t stream = 0);
+    void SeedRandom(uint64_t seed, uint64_t stream = 0);
+    void SetRandomSource(RandomSource source, void* context); //nullptr restores the built-in generator
+	bool LoadROM(char const* filename); //false if the file can't be read or doesn't fit in memory
+    bool LoadROM(std::span<const uint8_t> rom); //false if the ROM doesn't fit in memory
+    bool LoadROM(RomImage const& rom); //reuses the image's decoded instructions
+    bool Reset(RomImage const& rom, uint64_t seed, uint64_t stream = 0); //reboot with rom, as a new machine would
+    static std::shared_ptr<const DecodedProgram> Predecode(std::span<const uint8_t> rom);
+    void Cycle(); //fetch, decode and execute one instruction
+    void Run(uint32_t cycles); //execute a number of instructions
+    template <typename Hooks>
+    uint32_t Run(uint32_t cycles, Hooks& hooks); //instrumented interpreter, returns instructions executed
+    DecodedInstruction const& CurrentInstruction() const; //instruction most recently fetched
+    static unsigned int HandlerCount();
+    static uint8_t HandlerOf(uint16_t opcode); //handler an opcode dispatches to, 0 if unknown
+    static char const* HandlerName(uint8_t handler); //opcode pattern such as "DXYN"
+    void TickTimers(); //count the delay and sound timers down, 60 times a second
+    IdleState DetectIdle() const;
+    void FastForward(uint64_t cycle); //skip an idle machine ahead to cycle
+    void ExpandDisplay(uint32_t* pixels, uint32_t onColour = 0xFFFFFFFFU, uint32_t offColour = 0xFF000000U) const; //DisplayWidth() * DisplayHeight() pixels
+    unsigned int DisplayWidth() const; //64, or 128 in high resolution
+    unsigned int DisplayHeight() const; //32, or 64 in high resolution
+    uint64_t DirtyRows() const; //bit n set if display row n changed since ClearDirtyRows()
+    void ClearDirtyRows();
+    uint64_t DisplayGeneration() const; //increments on every display change
+    std::shared_ptr<const SnapshotBase> MakeSnapshotBase(); //full copy that later snapshots build on
+    void TakeSnapshot(Snapshot& snapshot); //reuses snapshot's page buffer
+    Snapshot TakeSnapshot();
+    void Restore(Snapshot const& snapshot);
+    void SaveImage(StateImage& image) const;
+    bool Restore(StateImage const& image); //false if the image is from another version or variant, or holds an impossible state
+    static uint16_t StateVariant();
+
+    static constexpr unsigned int DISPLAY_ROWS = Quirks::superChip ? 64 : 32;
+    static constexpr unsigned int ROW_WORDS = Quirks::superChip ? 2 : 1; //64 pixel words per display row
+
     uint8_t registers[16]{}; // stores 16 8-bit registers
     uint16_t pcRegister{}; //stores next instruction memory address
     uint16_t indexRegister{}; //stores memory addresses for operations
-    uint16_t stack[16]{}; //16 level 16-bit stack
     uint8_t sp{}; //stack pointer
     uint8_t timer{}; //60 hz timer
     uint8_t soundTimer{}; //60 hz timer for sound output
-    uint8_t keypad[16]{}; //16 keys, 0 through F
-    uint32_t display[32 * 64]{}; //32 by 64 pixel video display
+    ExecutionMode executionMode = ExecutionMode::Interpreter;
     uint16_t opcode{}; //stores the op code that maps to the opcode on a chip-8
+    uint64_t cycleCount{}; //instructions executed since boot
+
+private:
+    DecodedInstruction ins{}; //instruction currently executing
+    uint64_t modifiedPages = ~0ULL; //one bit per 64 byte page written since decodeCache was built
+    std::shared_ptr<const DecodedProgram> decodeCache;
+
+public:
+    uint16_t stack[16]{}; //16 level 16-bit stack
+    uint8_t keypad[16]{}; //16 keys, 0 through F
+    bool highResolution = false; //SUPER-CHIP 128 * 64 mode
+    uint8_t rplFlags[8]{}; //SUPER-CHIP user flags saved by FX75
+    uint64_t display[DISPLAY_ROWS][ROW_WORDS]{}; //rows of 64 or 128 pixels, the leftmost is the highest bit of the first word; low resolution uses the top left 64 * 32
+    uint8_t memory[4096]; //4 kB of memory
+
+private:
+    uint64_t dirtyRows = 0; //display rows changed since ClearDirtyRows()
+    uint64_t displayGeneration = 0; //display changes since construction
+
+    std::shared_ptr<const SnapshotBase> snapshotBase;
+    uint64_t snapshotDirtyPages = ~0ULL; //pages written since snapshotBase was taken
+
+    Pcg32 rng{};
+    RandomSource randomSource = nullptr; //replaces rng when set
+    void* randomContext = nullptr;
 
-private: 
-    std::default_random_engine randGen;
-    std::uniform_int_distribution<uint8_t> randByte;
+    typedef void (Chip8Core::*Chip8Func)();
+    static const Chip8Func handlers[]; //indexed by DecodedInstruction::handler, entry 0 catches unknown opcodes
+
+    static uint16_t ReadOpcode(const uint8_t* image, uint16_t address);
+    uint16_t FetchOpcode(uint16_t address) const;
+    static DecodedInstruction Decode(uint16_t op);
+    static std::shared_ptr<DecodedProgram> DecodeImage(const uint8_t* image);
+    void BuildDecodeCache();
+    void CopyROM(std::span<const uint8_t> rom);
+    void MarkWritten(uint16_t address, uint16_t length);
+    bool FindTimerSpin(uint16_t& head, uint8_t& Vx) const;
+    void SaveState(MachineState& state) const;
+    void LoadState(MachineState const& state);
+    void RunThreaded(uint32_t cycles);
+    void DrawSprite(uint8_t x, uint8_t y, unsigned int height, unsigned int width);
+    void ClearDisplay();
+    void DisplayChanged(uint64_t rows);
+
+    // Unknown or unsupported opcode, does nothing
+    void OP_NULL();
 
     // CHIP-8 Instructions
       
@@ -32,6 +274,24 @@ private:
     
     // (RET) Return from a subroutine
     void OP_00EE(); 
+
+    // (SCD nibble) Scroll the display down n rows, SUPER-CHIP
+    void OP_00CN();
+
+    // (SCR) Scroll the display right 4 pixels, SUPER-CHIP
+    void OP_00FB();
+
+    // (SCL) Scroll the display left 4 pixels, SUPER-CHIP
+    void OP_00FC();
+
+    // (EXIT) Stop the interpreter, SUPER-CHIP
+    void OP_00FD();
+
+    // (LOW) Switch to 64 * 32 resolution, SUPER-CHIP
+    void OP_00FE();
+
+    // (HIGH) Switch to 128 * 64 resolution, SUPER-CHIP
+    void OP_00FF();
     
     // (JP addr) Sets PC to nnn
     void OP_1NNN(); 
@@ -94,6 +354,7 @@ private:
     void OP_CXKK(); 
     
     // (DRW Vx, Vy, nibble) Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision
+    // With n = 0 SUPER-CHIP draws a 16 * 16 sprite
     void OP_DXYN(); 
     
     // (SKP Vx) Skip next instruction if key with value of Vx is pressed
@@ -120,6 +381,9 @@ private:
     // (LD F, Vx) Set I = location of sprite for digit Vx
     void OP_FX29(); 
     
+    // (LD HF, Vx) Set I = location of the 8 * 10 sprite for digit Vx, SUPER-CHIP
+    void OP_FX30();
+
     // (LD B, Vx) Store BCD representation of Vx in memory locations I, I+1, and I+2
     void OP_FX33(); 
     
@@ -129,4 +393,50 @@ private:
     // (LD Vx, [I]) Read registers V0 through Vx from memory starting at location I
     void OP_FX65(); 
 
-};
\ No newline at end of file
+    // (LD R, Vx) Store registers V0 through Vx in the RPL flags, SUPER-CHIP
+    void OP_FX75();
+
+    // (LD Vx, R) Read registers V0 through Vx from the RPL flags, SUPER-CHIP
+    void OP_FX85();
+
+};
+
+typedef Chip8Core<Chip8Quirks> Chip8;
+typedef Chip8Core<CosmacQuirks> CosmacChip8;
+typedef Chip8Core<SuperChipQuirks> SuperChip8;
+typedef Chip8Core<XoChipQuirks> XoChip8;
+
+extern template class Chip8Core<Chip8Quirks>;
+extern template class Chip8Core<CosmacQuirks>;
+extern template class Chip8Core<SuperChipQuirks>;
+extern template class Chip8Core<XoChipQuirks>;
+
+/**
+ * @brief Interpret instructions one at a time, calling hooks around each one.
+ * hooks.BeforeInstruction(chip, address) runs before the instruction at address and may stop the run 
+ * by returning false; hooks.AfterInstruction(chip, address) runs once it has executed.
+ * Being a template, the hooks inline into the loop and cost nothing in the plain Run().
+ * 
+ * @param cycles most instructions to execute
+ * @param hooks instrumentation called around every instruction
+ * @return instructions executed
+ */
+template <typename Quirks>
+template <typename Hooks>
+uint32_t Chip8Core<Quirks>::Run(uint32_t cycles, Hooks& hooks)
+{
+    uint32_t executed = 0;
+    while (executed < cycles)
+    {
+        uint16_t address = pcRegister & 0x0FFFU;
+        if (!hooks.BeforeInstruction(*this, address))
+        {
+            break;
+        }
+
+        Cycle();
+        executed++;
+        hooks.AfterInstruction(*this, address);
+    }
+    return executed;
+}
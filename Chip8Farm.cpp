@@ -0,0 +1,223 @@
+/**
+ * @file Chip8Farm.cpp
+ * @brief Runs many Chip-8 machines in parallel on a work-stealing thread pool.
+ * 
+ */
+
+#include "Chip8Farm.hpp"
+#include <chrono>
+
+/**
+ * @brief Start the worker threads, which sleep until the first ParallelFor.
+ * 
+ * @param threads number of workers, at least one is always started
+ */
+WorkStealingPool::WorkStealingPool(unsigned int threads)
+{
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+
+    for (unsigned int i = 0; i < threads; i++)
+    {
+        this->threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+    }
+}
+
+/**
+ * @brief Wake every worker so it exits, then join them.
+ * 
+ */
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+unsigned int WorkStealingPool::Size() const
+{
+    return static_cast<unsigned int>(workers.size());
+}
+
+/**
+ * @brief Run task(i) for every i in [0, count) across the workers.
+ * Each worker is handed a contiguous share of the indices up front, 
+ * and idle workers steal from the others so uneven tasks still finish together.
+ * 
+ * @param count number of tasks
+ * @param task called once per index, from any worker thread
+ */
+void WorkStealingPool::ParallelFor(size_t count, std::function<void(size_t)> const& task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(jobLock);
+
+    size_t workerCount = workers.size();
+    for (size_t w = 0; w < workerCount; w++)
+    {
+        std::lock_guard<std::mutex> queueGuard(workers[w]->lock);
+        for (size_t i = w * count / workerCount; i < (w + 1) * count / workerCount; i++)
+        {
+            workers[w]->tasks.push_back(i);
+        }
+    }
+
+    remaining = count;
+    job = &task;
+    jobGeneration++;
+    jobReady.notify_all();
+
+    //A worker can still be looking for tasks after the last one finishes, so wait for it to let go of the job
+    jobDone.wait(guard, [this] { return remaining == 0 && busyWorkers == 0; });
+    job = nullptr;
+}
+
+/**
+ * @brief Take the next task index, from the front of this worker's deque 
+ * or else from the back of another worker's.
+ * 
+ * @param id worker looking for work
+ * @param task set to the index taken
+ * @return false once every deque is empty
+ */
+bool WorkStealingPool::TakeTask(unsigned int id, size_t& task)
+{
+    {
+        std::lock_guard<std::mutex> guard(workers[id]->lock);
+        if (!workers[id]->tasks.empty())
+        {
+            task = workers[id]->tasks.front();
+            workers[id]->tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < workers.size(); offset++)
+    {
+        Worker& victim = *workers[(id + offset) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Wait for a job, run tasks until none are left anywhere, then wait again.
+ * 
+ * @param id index of this worker's deque
+ */
+void WorkStealingPool::WorkerLoop(unsigned int id)
+{
+    uint64_t seenGeneration = 0;
+    while (true)
+    {
+        std::function<void(size_t)> const* current;
+        {
+            std::unique_lock<std::mutex> guard(jobLock);
+            jobReady.wait(guard, [&] { return stopping || jobGeneration != seenGeneration; });
+            if (stopping)
+            {
+                return;
+            }
+
+            seenGeneration = jobGeneration;
+            current = job;
+            if (current == nullptr)
+            {
+                continue; //woke after that job already finished
+            }
+            busyWorkers++;
+        }
+
+        size_t task;
+        while (TakeTask(id, task))
+        {
+            (*current)(task);
+            remaining--;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(jobLock);
+            busyWorkers--;
+        }
+        jobDone.notify_all();
+    }
+}
+
+double FarmStats::InstructionsPerSecond() const
+{
+    return seconds > 0 ? instructions / seconds : 0;
+}
+
+/**
+ * @brief Construct every machine up front in one contiguous arena.
+ * 
+ * @param machines number of Chip8 instances
+ * @param threads number of worker threads
+ */
+Chip8Farm::Chip8Farm(size_t machines, unsigned int threads)
+        : arena(machines), pool(threads)
+{
+}
+
+Chip8& Chip8Farm::operator[](size_t index)
+{
+    return arena[index].machine;
+}
+
+size_t Chip8Farm::Size() const
+{
+    return arena.size();
+}
+
+WorkStealingPool& Chip8Farm::Pool()
+{
+    return pool;
+}
+
+/**
+ * @brief Execute the same number of instructions on every machine, in parallel.
+ * 
+ * @param cycles instructions to execute per machine
+ * @return total instructions executed and the wall time it took
+ */
+FarmStats Chip8Farm::Run(uint32_t cycles)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    pool.ParallelFor(arena.size(), [this, cycles](size_t index)
+    {
+        arena[index].machine.Run(cycles);
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    FarmStats stats;
+    stats.instructions = uint64_t(arena.size()) * cycles;
+    stats.seconds = elapsed.count();
+    return stats;
+}
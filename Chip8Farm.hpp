@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads that run parallel loops. Every worker owns a deque of task
+// indices and steals from the back of another worker's deque once its own is empty.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned int threads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+    WorkStealingPool(WorkStealingPool const&) = delete;
+    WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+    void ParallelFor(size_t count, std::function<void(size_t)> const& task); //blocks until task ran for every index
+    unsigned int Size() const; //number of worker threads
+
+private:
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex jobLock;
+    std::condition_variable jobReady; //workers wait here for the next ParallelFor
+    std::condition_variable jobDone; //ParallelFor waits here for the last task
+    std::function<void(size_t)> const* job = nullptr;
+    uint64_t jobGeneration = 0;
+    unsigned int busyWorkers = 0; //workers still holding the current job
+    std::atomic<size_t> remaining{0}; //tasks of the current job not yet finished
+    bool stopping = false;
+
+    void WorkerLoop(unsigned int id);
+    bool TakeTask(unsigned int id, size_t& task);
+};
+
+// Totals from one Chip8Farm::Run
+struct FarmStats
+{
+    uint64_t instructions;
+    double seconds;
+
+    double InstructionsPerSecond() const;
+};
+
+// Owns many Chip8 machines in one contiguous arena, each on its own cache lines,
+// and runs them across a WorkStealingPool
+class Chip8Farm
+{
+public:
+    explicit Chip8Farm(size_t machines, unsigned int threads = std::thread::hardware_concurrency());
+
+    Chip8& operator[](size_t index);
+    size_t Size() const;
+    WorkStealingPool& Pool();
+
+    FarmStats Run(uint32_t cycles); //execute cycles instructions on every machine
+
+private:
+    // Keeps neighbouring machines from sharing a cache line between threads
+    struct alignas(64) Slot
+    {
+        Chip8 machine;
+    };
+
+    std::vector<Slot> arena;
+    WorkStealingPool pool;
+};
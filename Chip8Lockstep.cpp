@@ -0,0 +1,349 @@
+/**
+ * @file Chip8Lockstep.cpp
+ * @brief Structure-of-arrays interpreter that executes many Chip-8 machines in lockstep.
+ * 
+ * The per-lane loops below are kept free of branches so GCC, Clang and MSVC vectorise them 
+ * for whatever SIMD width the build targets, e.g. -mavx2 or -mavx512bw.
+ * 
+ */
+
+#include "Chip8Lockstep.hpp"
+#include "RomRegistry.hpp"
+#include <cstring>
+
+const unsigned int REGISTER_VF = 15;
+
+/**
+ * @brief Construct every lane as a fresh machine.
+ * 
+ * @param lanes number of machines to run in lockstep
+ */
+Chip8Lockstep::Chip8Lockstep(size_t lanes)
+        : machines(lanes), pcRegister(lanes), indexRegister(lanes), remaining(lanes), executed(lanes), opcode(lanes), mask(lanes)
+{
+    for (std::vector<uint8_t>& reg : registers)
+    {
+        reg.resize(lanes);
+    }
+}
+
+Chip8& Chip8Lockstep::operator[](size_t lane)
+{
+    return machines[lane];
+}
+
+size_t Chip8Lockstep::Size() const
+{
+    return machines.size();
+}
+
+/**
+ * @brief Read a ROM once and load it into every lane.
+ * 
+ * @param filename path of the ROM
+ * @return false if the file can't be read or doesn't fit in memory
+ */
+bool Chip8Lockstep::LoadROM(char const* filename)
+{
+    RomRegistry registry;
+    RomHandle rom = registry.Load(filename);
+    return rom && LoadROM(*rom);
+}
+
+/**
+ * @brief Load the same ROM into every lane, sharing its decoded instructions.
+ * 
+ * @param rom image from a RomRegistry
+ * @return false if the ROM doesn't fit in memory
+ */
+bool Chip8Lockstep::LoadROM(RomImage const& rom)
+{
+    for (Chip8& machine : machines)
+    {
+        if (!machine.LoadROM(rom))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Copy one lane's registers from its machine into the lane arrays.
+ * 
+ * @param lane lane to copy
+ */
+void Chip8Lockstep::Gather(size_t lane)
+{
+    Chip8& machine = machines[lane];
+    for (unsigned int r = 0; r < 16; r++)
+    {
+        registers[r][lane] = machine.registers[r];
+    }
+    pcRegister[lane] = machine.pcRegister;
+    indexRegister[lane] = machine.indexRegister;
+    opcode[lane] = machine.opcode;
+}
+
+/**
+ * @brief Copy one lane's registers from the lane arrays back into its machine, 
+ * and count the instructions it executed in vector steps since then into its cycleCount.
+ * 
+ * @param lane lane to copy
+ */
+void Chip8Lockstep::Scatter(size_t lane)
+{
+    Chip8& machine = machines[lane];
+    for (unsigned int r = 0; r < 16; r++)
+    {
+        machine.registers[r] = registers[r][lane];
+    }
+    machine.pcRegister = pcRegister[lane];
+    machine.indexRegister = indexRegister[lane];
+    machine.opcode = opcode[lane];
+    machine.cycleCount += executed[lane];
+    executed[lane] = 0;
+}
+
+/**
+ * @brief Execute one instruction on a single lane with the normal interpreter.
+ * 
+ * @param lane lane to step
+ */
+void Chip8Lockstep::StepLane(size_t lane)
+{
+    Scatter(lane);
+    machines[lane].Cycle();
+    Gather(lane);
+    scalarInstructions++;
+}
+
+/**
+ * @brief Execute cycles instructions on every lane.
+ * The lane arrays are loaded from the machines at the start and written back at the end, 
+ * so the machines are the whole state between calls.
+ * 
+ * @param cycles instructions to execute per lane
+ */
+void Chip8Lockstep::Run(uint32_t cycles)
+{
+    size_t lanes = machines.size();
+
+    sharedCode = true;
+    for (size_t lane = 0; lane < lanes; lane++)
+    {
+        Gather(lane);
+        remaining[lane] = cycles;
+        if (memcmp(machines[lane].memory, machines[0].memory, sizeof(machines[0].memory)) != 0)
+        {
+            sharedCode = false;
+        }
+    }
+
+    while (Step())
+    {
+    }
+
+    for (size_t lane = 0; lane < lanes; lane++)
+    {
+        Scatter(lane);
+    }
+}
+
+/**
+ * @brief Execute one instruction on every lane that has instructions left and sits at the lowest PC.
+ * 
+ * @return false once no lane has instructions left
+ */
+bool Chip8Lockstep::Step()
+{
+    size_t lanes = machines.size();
+
+    size_t leader = lanes;
+    for (size_t lane = 0; lane < lanes; lane++)
+    {
+        if (remaining[lane] != 0 && (leader == lanes || pcRegister[lane] < pcRegister[leader]))
+        {
+            leader = lane;
+        }
+    }
+    if (leader == lanes)
+    {
+        return false;
+    }
+
+    uint16_t address = pcRegister[leader];
+    const uint8_t* memory = machines[leader].memory;
+    uint16_t op = (memory[address & 0x0FFFU] << 8U) | memory[(address + 1U) & 0x0FFFU];
+
+    for (size_t lane = 0; lane < lanes; lane++)
+    {
+        mask[lane] = remaining[lane] != 0 && pcRegister[lane] == address;
+    }
+
+    //Once a lane has written memory its code can differ from the leader's
+    if (!sharedCode)
+    {
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            const uint8_t* laneMemory = machines[lane].memory;
+            uint16_t laneOp = (laneMemory[address & 0x0FFFU] << 8U) | laneMemory[(address + 1U) & 0x0FFFU];
+            mask[lane] &= laneOp == op;
+        }
+    }
+
+    if (ExecuteVector(op))
+    {
+        vectorInstructions++;
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            executed[lane] += mask[lane];
+            opcode[lane] = mask[lane] ? op : opcode[lane];
+        }
+    } else
+    {
+        //FX33 and FX55 write memory, after which the lanes' code may no longer match
+        if ((op & 0xF0FFU) == 0xF033U || (op & 0xF0FFU) == 0xF055U)
+        {
+            sharedCode = false;
+        }
+
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            if (mask[lane])
+            {
+                StepLane(lane);
+            }
+        }
+    }
+
+    for (size_t lane = 0; lane < lanes; lane++)
+    {
+        remaining[lane] -= mask[lane];
+    }
+    return true;
+}
+
+/**
+ * @brief Execute an opcode on every masked lane at once, with the same semantics as the Chip8 handler.
+ * Like the handlers, 8XY4 to 8XYE write VF after Vx, so with x = F the flag is what remains.
+ * Unmasked lanes keep their values through a select, so the loops have no branches.
+ * 
+ * @param op opcode the masked lanes are about to execute
+ * @return false if the opcode has no vector form and must run lane by lane
+ */
+bool Chip8Lockstep::ExecuteVector(uint16_t op)
+{
+    size_t lanes = machines.size();
+    uint8_t x = (op & 0x0F00U) >> 8U;
+    uint8_t y = (op & 0x00F0U) >> 4U;
+    uint8_t kk = op & 0x00FFU;
+    uint16_t nnn = op & 0x0FFFU;
+
+    uint8_t* vx = registers[x].data();
+    uint8_t* vy = registers[y].data();
+    uint8_t* vf = registers[REGISTER_VF].data();
+    uint16_t* pc = pcRegister.data();
+    uint16_t* index = indexRegister.data();
+    const uint8_t* m = mask.data();
+
+    switch (op >> 12U)
+    {
+    case 0x1:
+        for (size_t l = 0; l < lanes; l++) pc[l] = m[l] ? nnn : pc[l];
+        return true;
+    case 0x3:
+        for (size_t l = 0; l < lanes; l++) pc[l] += m[l] * ((vx[l] == kk) ? 4 : 2);
+        return true;
+    case 0x4:
+        for (size_t l = 0; l < lanes; l++) pc[l] += m[l] * ((vx[l] != kk) ? 4 : 2);
+        return true;
+    case 0x6:
+        for (size_t l = 0; l < lanes; l++) vx[l] = m[l] ? kk : vx[l];
+        break;
+    case 0x7:
+        for (size_t l = 0; l < lanes; l++) vx[l] += m[l] * kk;
+        break;
+    case 0x8:
+        switch (op & 0x000FU)
+        {
+        case 0x0:
+            for (size_t l = 0; l < lanes; l++) vx[l] = m[l] ? vy[l] : vx[l];
+            break;
+        case 0x1:
+            for (size_t l = 0; l < lanes; l++) vx[l] |= m[l] ? vy[l] : 0;
+            break;
+        case 0x2:
+            for (size_t l = 0; l < lanes; l++) vx[l] &= m[l] ? vy[l] : 0xFFU;
+            break;
+        case 0x3:
+            for (size_t l = 0; l < lanes; l++) vx[l] ^= m[l] ? vy[l] : 0;
+            break;
+        case 0x4:
+            for (size_t l = 0; l < lanes; l++)
+            {
+                uint16_t sum = vx[l] + vy[l];
+                vx[l] = m[l] ? (sum & 0x00FFU) : vx[l];
+                vf[l] = m[l] ? (sum > 0x00FFU) : vf[l];
+            }
+            break;
+        case 0x5:
+            for (size_t l = 0; l < lanes; l++)
+            {
+                uint8_t notBorrow = vx[l] > vy[l];
+                vx[l] -= m[l] ? vy[l] : 0;
+                vf[l] = m[l] ? notBorrow : vf[l];
+            }
+            break;
+        case 0x6:
+            for (size_t l = 0; l < lanes; l++)
+            {
+                uint8_t lsb = vx[l] & 1U;
+                vx[l] = m[l] ? (vx[l] >> 1U) : vx[l];
+                vf[l] = m[l] ? lsb : vf[l];
+            }
+            break;
+        case 0x7:
+            for (size_t l = 0; l < lanes; l++)
+            {
+                uint8_t notBorrow = vy[l] > vx[l];
+                vx[l] = m[l] ? uint8_t(vy[l] - vx[l]) : vx[l];
+                vf[l] = m[l] ? notBorrow : vf[l];
+            }
+            break;
+        case 0xE:
+            for (size_t l = 0; l < lanes; l++)
+            {
+                uint8_t msb = (vx[l] & 0x80U) >> 7U;
+                vx[l] = m[l] ? uint8_t(vx[l] << 1U) : vx[l];
+                vf[l] = m[l] ? msb : vf[l];
+            }
+            break;
+        default:
+            return false;
+        }
+        break;
+    case 0x9:
+        if ((op & 0x000FU) != 0)
+        {
+            return false;
+        }
+        for (size_t l = 0; l < lanes; l++) pc[l] += m[l] * ((vx[l] != vy[l]) ? 4 : 2);
+        return true;
+    case 0xA:
+        for (size_t l = 0; l < lanes; l++) index[l] = m[l] ? nnn : index[l];
+        break;
+    case 0xF:
+        if ((op & 0x00FFU) != 0x1EU)
+        {
+            return false;
+        }
+        for (size_t l = 0; l < lanes; l++) index[l] += m[l] * vx[l];
+        break;
+    default:
+        return false;
+    }
+
+    for (size_t l = 0; l < lanes; l++) pc[l] += m[l] * 2;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <vector>
+
+// Runs many copies of a machine in lockstep with their registers stored structure-of-arrays.
+// Each step executes the lanes sitting at the lowest PC, so lanes that diverge on a skip
+// wait for each other and reconverge. ALU, skip and jump instructions execute as one masked
+// loop over all lanes, which the compiler turns into SIMD operations; anything else runs
+// through each lane's own Chip8::Cycle().
+class Chip8Lockstep
+{
+public:
+    explicit Chip8Lockstep(size_t lanes);
+
+    Chip8& operator[](size_t lane); //full state of one lane between calls to Run
+    size_t Size() const;
+
+    bool LoadROM(char const* filename); //loads the same ROM into every lane
+    bool LoadROM(RomImage const& rom);
+    void Run(uint32_t cycles); //execute cycles instructions on every lane
+
+    uint64_t vectorInstructions = 0; //instructions executed once for all lanes
+    uint64_t scalarInstructions = 0; //instructions executed one lane at a time
+
+private:
+    std::vector<Chip8> machines; //memory, display, stack, timers and keypad per lane
+    std::vector<uint8_t> registers[16]; //registers[r][lane]
+    std::vector<uint16_t> pcRegister; //pcRegister[lane]
+    std::vector<uint16_t> indexRegister; //indexRegister[lane]
+    std::vector<uint32_t> remaining; //instructions each lane has left in this Run
+    std::vector<uint32_t> executed; //vector instructions each lane ran since it was last scattered
+    std::vector<uint16_t> opcode; //opcode[lane], the instruction the lane last executed
+    std::vector<uint8_t> mask; //1 for lanes executing the current step
+    bool sharedCode = false; //every lane's memory holds the same bytes
+
+    void Gather(size_t lane);
+    void Scatter(size_t lane);
+    void StepLane(size_t lane);
+    bool Step();
+    bool ExecuteVector(uint16_t op);
+};
@@ -0,0 +1,76 @@
+/**
+ * @file Debugger.cpp
+ * @brief Breakpoint and watch bookkeeping for the debugger hooks.
+ * 
+ */
+
+#include "Debugger.hpp"
+
+const unsigned int MEMORY_SIZE = 4096;
+
+void Debugger::SetBreakpoint(uint16_t address, bool enabled)
+{
+    breakpoints.set(address & (MEMORY_SIZE - 1), enabled);
+}
+
+bool Debugger::HasBreakpoint(uint16_t address) const
+{
+    return breakpoints.test(address & (MEMORY_SIZE - 1));
+}
+
+/**
+ * @brief Watch or stop watching a range of memory for writes by instructions, wrapping at the end of memory.
+ * 
+ * @param address first byte
+ * @param length number of bytes
+ * @param enabled false to stop watching them
+ */
+void Debugger::WatchMemory(uint16_t address, uint16_t length, bool enabled)
+{
+    for (unsigned int i = 0; i < length && i < MEMORY_SIZE; i++)
+    {
+        watchedMemory.set((address + i) & (MEMORY_SIZE - 1), enabled);
+    }
+    watchingMemory = watchedMemory.any();
+}
+
+void Debugger::WatchRegister(uint8_t reg, bool enabled)
+{
+    uint16_t bit = static_cast<uint16_t>(1U << (reg & 0x0FU));
+    watchedRegisters = enabled ? (watchedRegisters | bit) : (watchedRegisters & ~bit);
+}
+
+void Debugger::ClearAll()
+{
+    breakpoints.reset();
+    watchedMemory.reset();
+    watchingMemory = false;
+    watchedRegisters = 0;
+}
+
+DebugStop const& Debugger::LastStop() const
+{
+    return stop;
+}
+
+/**
+ * @brief The memory an instruction writes, FX33 the three BCD digits and FX55 registers V0 to Vx, starting at I.
+ * 
+ * @param opcode instruction
+ * @param length set to the number of bytes written
+ * @return false if the instruction doesn't write memory
+ */
+bool Debugger::WriteRange(uint16_t opcode, unsigned int& length) const
+{
+    if ((opcode & 0xF0FFU) == 0xF033U)
+    {
+        length = 3;
+        return true;
+    }
+    if ((opcode & 0xF0FFU) == 0xF055U)
+    {
+        length = ((opcode >> 8U) & 0x0FU) + 1U;
+        return true;
+    }
+    return false;
+}
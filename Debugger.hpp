@@ -0,0 +1,178 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <bitset>
+
+// Why a debugger run stopped
+enum class StopReason : uint8_t
+{
+    None, //ran every instruction asked for
+    Breakpoint, //about to execute an instruction at a breakpoint
+    Watchpoint, //an instruction wrote a watched byte of memory
+    RegisterChanged //an instruction changed a watched register
+};
+
+struct DebugStop
+{
+    StopReason reason = StopReason::None;
+    uint16_t pc = 0; //address of the breakpoint, or of the instruction that hit the watch
+    uint16_t address = 0; //watched byte written
+    uint8_t reg = 0; //watched register changed
+    uint8_t oldValue = 0; //register or memory byte before the instruction
+    uint8_t newValue = 0; //register or memory byte after the instruction
+};
+
+// PC breakpoints, memory write watchpoints, register watches, VF included, and single-stepping
+// for ROM development. It is a set of hooks for Chip8Core::Run(cycles, hooks), so the checks only exist
+// in the instrumented interpreter instantiated for the debugger; the plain Run() has no debug branch
+// whether or not anything is armed. Works with any Chip8Core variant.
+class Debugger
+{
+public:
+    void SetBreakpoint(uint16_t address, bool enabled = true);
+    bool HasBreakpoint(uint16_t address) const;
+    void WatchMemory(uint16_t address, uint16_t length = 1, bool enabled = true); //writes by FX33 and FX55
+    void WatchRegister(uint8_t reg, bool enabled = true); //0xF watches the flag register
+    void ClearAll();
+
+    template <typename Machine>
+    DebugStop Continue(Machine& chip, uint32_t cycles); //runs until something is hit or cycles have run
+    template <typename Machine>
+    DebugStop Step(Machine& chip); //one instruction, even from a breakpoint
+    DebugStop const& LastStop() const;
+
+    template <typename Machine>
+    bool BeforeInstruction(Machine& chip, uint16_t address);
+    template <typename Machine>
+    void AfterInstruction(Machine& chip, uint16_t address);
+
+private:
+    std::bitset<4096> breakpoints;
+    std::bitset<4096> watchedMemory;
+    bool watchingMemory = false; //any bit of watchedMemory is set
+    uint16_t watchedRegisters = 0; //bit n watches Vn
+    DebugStop stop;
+    bool stopping = false; //an instruction hit a watch, stop before the next one
+    bool resuming = false; //ignore a breakpoint on the first instruction of a run
+    uint16_t indexBefore = 0;
+    uint8_t registersBefore[16]{};
+    uint8_t memoryBefore[16]{}; //bytes the current instruction may write
+
+    template <typename Machine>
+    DebugStop RunFor(Machine& chip, uint32_t cycles, bool skipBreakpoint);
+    bool WriteRange(uint16_t opcode, unsigned int& length) const;
+};
+
+/**
+ * @brief Run until a breakpoint or watch is hit. If the last run stopped at a breakpoint on the current PC,
+ * that breakpoint is stepped over so Continue moves on.
+ * 
+ * @param chip machine to run
+ * @param cycles most instructions to execute
+ * @return why the run stopped
+ */
+template <typename Machine>
+DebugStop Debugger::Continue(Machine& chip, uint32_t cycles)
+{
+    bool atBreakpoint = stop.reason == StopReason::Breakpoint && stop.pc == (chip.pcRegister & 0x0FFFU);
+    return RunFor(chip, cycles, atBreakpoint);
+}
+
+/**
+ * @brief Execute a single instruction, ignoring any breakpoint on it but still reporting watches.
+ * 
+ * @param chip machine to step
+ * @return StopReason::None, or the watch the instruction hit
+ */
+template <typename Machine>
+DebugStop Debugger::Step(Machine& chip)
+{
+    return RunFor(chip, 1, true);
+}
+
+template <typename Machine>
+DebugStop Debugger::RunFor(Machine& chip, uint32_t cycles, bool skipBreakpoint)
+{
+    stop = DebugStop{};
+    stopping = false;
+    resuming = skipBreakpoint;
+    chip.Run(cycles, *this);
+    return stop;
+}
+
+/**
+ * @brief Hook run before each instruction: stops at breakpoints and after a watch was hit,
+ * otherwise remembers what watched state looks like before the instruction.
+ * 
+ * @param chip machine being debugged
+ * @param address PC of the instruction about to execute
+ * @return false to stop the run before the instruction
+ */
+template <typename Machine>
+bool Debugger::BeforeInstruction(Machine& chip, uint16_t address)
+{
+    if (stopping)
+    {
+        return false;
+    }
+    if (breakpoints.test(address) && !resuming)
+    {
+        stop = DebugStop{StopReason::Breakpoint, address};
+        return false;
+    }
+    resuming = false;
+
+    if (watchedRegisters != 0)
+    {
+        for (unsigned int r = 0; r < 16; r++)
+        {
+            registersBefore[r] = chip.registers[r];
+        }
+    }
+
+    unsigned int length;
+    if (watchingMemory && WriteRange(chip.memory[address] << 8U | chip.memory[(address + 1U) & 0x0FFFU], length))
+    {
+        indexBefore = chip.indexRegister;
+        for (unsigned int i = 0; i < length; i++)
+        {
+            memoryBefore[i] = chip.memory[(indexBefore + i) & 0x0FFFU];
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Hook run after each instruction: checks the memory it wrote and the watched registers.
+ * 
+ * @param chip machine being debugged
+ * @param address PC the instruction executed at
+ */
+template <typename Machine>
+void Debugger::AfterInstruction(Machine& chip, uint16_t address)
+{
+    unsigned int length;
+    if (watchingMemory && WriteRange(chip.opcode, length))
+    {
+        for (unsigned int i = 0; i < length; i++)
+        {
+            uint16_t written = (indexBefore + i) & 0x0FFFU;
+            if (watchedMemory.test(written))
+            {
+                stop = DebugStop{StopReason::Watchpoint, address, written, 0, memoryBefore[i], chip.memory[written]};
+                stopping = true;
+                return;
+            }
+        }
+    }
+
+    for (unsigned int r = 0; watchedRegisters != 0 && r < 16; r++)
+    {
+        if ((watchedRegisters >> r & 1U) && chip.registers[r] != registersBefore[r])
+        {
+            stop = DebugStop{StopReason::RegisterChanged, address, 0, static_cast<uint8_t>(r), registersBefore[r], chip.registers[r]};
+            stopping = true;
+            return;
+        }
+    }
+}
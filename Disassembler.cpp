@@ -0,0 +1,48 @@
+/**
+ * @file Disassembler.cpp
+ * @brief Command-line front end to RomAnalysis: disassembly listing or control-flow graph of a ROM.
+ * 
+ * Usage: disassembler [--dot] rom.ch8
+ * The listing marks loop headers, blocks the program writes over and writes through an unknown I.
+ * With --dot the control-flow graph is written for Graphviz instead, e.g. disassembler --dot rom.ch8 | dot -Tsvg
+ * 
+ */
+
+#include "RomAnalysis.hpp"
+#include "RomRegistry.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    bool dot = argc == 3 && strcmp(argv[1], "--dot") == 0;
+    if (argc != 2 && !dot)
+    {
+        fprintf(stderr, "usage: %s [--dot] rom.ch8\n", argv[0]);
+        return 2;
+    }
+
+    MappedFile file(argv[argc - 1]);
+    if (!file.IsOpen())
+    {
+        fprintf(stderr, "%s: can't read\n", argv[argc - 1]);
+        return 1;
+    }
+
+    RomAnalysis analysis(file.Bytes());
+    if (!analysis.Loaded())
+    {
+        fprintf(stderr, "%s: does not fit in memory\n", argv[argc - 1]);
+        return 1;
+    }
+
+    if (dot)
+    {
+        analysis.WriteDot(std::cout);
+    } else
+    {
+        analysis.WriteListing(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,317 @@
+/**
+ * @file GpuDisplay.cpp
+ * @brief Packing the display into a 1-bit texture, and the shaders and OpenGL backend that draw it.
+ * 
+ * The OpenGL part is only compiled with CHIP8_OPENGL defined; CHIP8_GL_HEADER names the application's
+ * GL loader header, otherwise the system headers are used with prototypes enabled.
+ * 
+ */
+
+#include "GpuDisplay.hpp"
+
+const unsigned int LOW_WIDTH = 64;
+const unsigned int LOW_HEIGHT = 32;
+const unsigned int HIGH_WIDTH = 128;
+const unsigned int HIGH_HEIGHT = 64;
+
+/**
+ * @brief Pack the visible part of 64 rows of 128 pixels a byte per 8 pixels, top row first.
+ * 
+ * @param display rows as in Frame, the leftmost pixel in bit 63 of the first word
+ * @param highResolution 128 * 64 if true, otherwise the top left 64 * 32
+ * @param texels at least PACKED_DISPLAY_BYTES
+ * @return bytes written
+ */
+size_t PackDisplay(uint64_t const display[64][2], bool highResolution, uint8_t* texels)
+{
+    unsigned int words = highResolution ? 2 : 1;
+    unsigned int height = highResolution ? HIGH_HEIGHT : LOW_HEIGHT;
+    uint8_t* next = texels;
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int word = 0; word < words; word++)
+        {
+            for (int shift = 56; shift >= 0; shift -= 8)
+            {
+                *next++ = static_cast<uint8_t>(display[y][word] >> shift);
+            }
+        }
+    }
+    return next - texels;
+}
+
+size_t PackDisplay(Frame const& frame, uint8_t* texels)
+{
+    return PackDisplay(frame.display, frame.highResolution, texels);
+}
+
+const char* const DISPLAY_VERTEX_SHADER = R"(#version 330 core
+out vec2 uv;
+void main()
+{
+    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* const DISPLAY_PRESENT_SHADER = R"(#version 330 core
+uniform usampler2D bits;
+uniform sampler2D intensity;
+uniform ivec2 size;
+uniform bool usePhosphor;
+uniform vec3 onColour;
+uniform vec3 offColour;
+in vec2 uv;
+out vec4 colour;
+void main()
+{
+    ivec2 pixel = clamp(ivec2(uv.x * float(size.x), (1.0 - uv.y) * float(size.y)), ivec2(0), size - 1);
+    float lit;
+    if (usePhosphor)
+    {
+        lit = texelFetch(intensity, pixel, 0).r;
+    } else
+    {
+        uint byte = texelFetch(bits, ivec2(pixel.x >> 3, pixel.y), 0).r;
+        lit = float((byte >> uint(7 - (pixel.x & 7))) & 1u);
+    }
+    colour = vec4(mix(offColour, onColour, lit), 1.0);
+}
+)";
+
+const char* const DISPLAY_PHOSPHOR_SHADER = R"(#version 330 core
+uniform usampler2D bits;
+uniform sampler2D intensity;
+uniform float decay;
+out vec4 colour;
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint byte = texelFetch(bits, ivec2(pixel.x >> 3, pixel.y), 0).r;
+    float lit = float((byte >> uint(7 - (pixel.x & 7))) & 1u);
+    colour = vec4(max(lit, texelFetch(intensity, pixel, 0).r * decay));
+}
+)";
+
+#ifdef CHIP8_OPENGL
+
+/**
+ * @brief Compile and link a vertex and fragment shader.
+ * 
+ * @return the program, or 0 if either stage fails
+ */
+static GLuint BuildProgram(char const* vertexSource, char const* fragmentSource)
+{
+    GLuint stages[2] = {glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER)};
+    char const* sources[2] = {vertexSource, fragmentSource};
+    GLuint program = glCreateProgram();
+    GLint ok = GL_TRUE;
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        GLint compiled;
+        glShaderSource(stages[i], 1, &sources[i], nullptr);
+        glCompileShader(stages[i]);
+        glGetShaderiv(stages[i], GL_COMPILE_STATUS, &compiled);
+        ok = ok && compiled;
+        glAttachShader(program, stages[i]);
+    }
+
+    GLint linked = GL_FALSE;
+    if (ok)
+    {
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    glDeleteShader(stages[0]);
+    glDeleteShader(stages[1]);
+    if (!linked)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/**
+ * @brief Make a texture with nearest filtering and no mipmaps.
+ * 
+ */
+static GLuint MakeTexture(GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+/**
+ * @brief Create the textures, framebuffer and shader programs in the current context.
+ * 
+ */
+GpuDisplay::GpuDisplay()
+{
+    bitsTexture = MakeTexture(GL_R8UI, HIGH_WIDTH / 8, HIGH_HEIGHT, GL_RED_INTEGER, GL_UNSIGNED_BYTE);
+    for (GLuint& texture : intensityTextures)
+    {
+        texture = MakeTexture(GL_R8, HIGH_WIDTH, HIGH_HEIGHT, GL_RED, GL_UNSIGNED_BYTE);
+    }
+    glGenFramebuffers(1, &framebuffer);
+    glGenVertexArrays(1, &vertexArray);
+
+    presentProgram = BuildProgram(DISPLAY_VERTEX_SHADER, DISPLAY_PRESENT_SHADER);
+    phosphorProgram = BuildProgram(DISPLAY_VERTEX_SHADER, DISPLAY_PHOSPHOR_SHADER);
+    for (GLuint program : {presentProgram, phosphorProgram})
+    {
+        if (program)
+        {
+            glUseProgram(program);
+            glUniform1i(glGetUniformLocation(program, "bits"), 0);
+            glUniform1i(glGetUniformLocation(program, "intensity"), 1);
+        }
+    }
+    glUseProgram(0);
+}
+
+GpuDisplay::~GpuDisplay()
+{
+    glDeleteProgram(presentProgram);
+    glDeleteProgram(phosphorProgram);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(2, intensityTextures);
+    glDeleteTextures(1, &bitsTexture);
+}
+
+bool GpuDisplay::Ready() const
+{
+    return presentProgram != 0 && phosphorProgram != 0;
+}
+
+void GpuDisplay::Upload(Frame const& frame)
+{
+    uint8_t texels[PACKED_DISPLAY_BYTES];
+    PackDisplay(frame, texels);
+    UploadPacked(texels, frame.highResolution);
+}
+
+/**
+ * @brief Replace the bits texture with a packed display, then with phosphor on render the next
+ * intensity texture from it and the previous one. The caller's framebuffer and viewport are restored.
+ * 
+ * @param texels packed display
+ * @param highResolution size of the packed display
+ */
+void GpuDisplay::UploadPacked(uint8_t const* texels, bool highResolution)
+{
+    width = highResolution ? HIGH_WIDTH : LOW_WIDTH;
+    height = highResolution ? HIGH_HEIGHT : LOW_HEIGHT;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitsTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width / 8, height, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels);
+
+    if (decay <= 0.0F || !Ready())
+    {
+        return;
+    }
+
+    GLint previousFramebuffer;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    unsigned int next = current ^ 1U;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, intensityTextures[next], 0);
+    glViewport(0, 0, width, height);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, intensityTextures[current]);
+    glUseProgram(phosphorProgram);
+    glUniform1f(glGetUniformLocation(phosphorProgram, "decay"), decay);
+    glBindVertexArray(vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    current = next;
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+/**
+ * @brief Clear the viewport to the off colour and draw the display centred in it at the largest
+ * whole-number scale that fits, so every CHIP-8 pixel covers the same number of screen pixels.
+ * 
+ * @param viewportWidth width of the bound framebuffer in pixels
+ * @param viewportHeight height of the bound framebuffer in pixels
+ */
+void GpuDisplay::Draw(int viewportWidth, int viewportHeight) const
+{
+    if (!Ready())
+    {
+        return;
+    }
+
+    int scale = viewportWidth / width < viewportHeight / height ? viewportWidth / width : viewportHeight / height;
+    scale = scale > 0 ? scale : 1;
+
+    glViewport(0, 0, viewportWidth, viewportHeight);
+    glClearColor(offColour[0], offColour[1], offColour[2], 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glViewport((viewportWidth - width * scale) / 2, (viewportHeight - height * scale) / 2, width * scale, height * scale);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bitsTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, intensityTextures[current]);
+    glUseProgram(presentProgram);
+    glUniform2i(glGetUniformLocation(presentProgram, "size"), width, height);
+    glUniform1i(glGetUniformLocation(presentProgram, "usePhosphor"), decay > 0.0F);
+    glUniform3fv(glGetUniformLocation(presentProgram, "onColour"), 1, onColour);
+    glUniform3fv(glGetUniformLocation(presentProgram, "offColour"), 1, offColour);
+    glBindVertexArray(vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+/**
+ * @brief Set the colours of lit and dark pixels.
+ * 
+ * @param on colour of lit pixels as 0xAARRGGBB
+ * @param off colour of dark pixels and the border as 0xAARRGGBB
+ */
+void GpuDisplay::SetPalette(uint32_t on, uint32_t off)
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        onColour[i] = ((on >> (16 - 8 * i)) & 0xFFU) / 255.0F;
+        offColour[i] = ((off >> (16 - 8 * i)) & 0xFFU) / 255.0F;
+    }
+}
+
+/**
+ * @brief Turn the phosphor fade on or off. Turning it on starts from a dark screen.
+ * 
+ * @param factor brightness a dark pixel keeps each frame, 0.0 to 1.0, or 0 to turn the effect off
+ */
+void GpuDisplay::SetPhosphor(float factor)
+{
+    if (factor > 0.0F && decay <= 0.0F)
+    {
+        uint8_t dark[HIGH_WIDTH * HIGH_HEIGHT]{};
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (GLuint texture : intensityTextures)
+        {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, HIGH_WIDTH, HIGH_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, dark);
+        }
+    }
+    decay = factor < 1.0F ? factor : 1.0F;
+}
+
+#endif
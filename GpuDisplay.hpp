@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Channels.hpp"
+
+// The display as a 1-bit texture: DisplayWidth() / 8 bytes per row, top row first, the leftmost pixel
+// in the highest bit of each byte. 256 bytes at 64 * 32 and 1 kB at 128 * 64, so a frontend uploads
+// that instead of expanding every pixel on the CPU, and the shaders below expand, scale and fade it.
+const unsigned int PACKED_DISPLAY_BYTES = 128 / 8 * 64; //largest packed display
+
+size_t PackDisplay(uint64_t const display[64][2], bool highResolution, uint8_t* texels); //returns bytes written
+size_t PackDisplay(Frame const& frame, uint8_t* texels);
+
+/**
+ * @brief Pack a machine's visible display as a 1-bit texture.
+ * 
+ * @param chip machine to pack, any Chip8Core variant
+ * @param texels at least PACKED_DISPLAY_BYTES
+ * @return bytes written
+ */
+template <typename Machine>
+size_t PackDisplay(Machine const& chip, uint8_t* texels)
+{
+    uint64_t rows[64][2]{};
+    CopyDisplay(chip, rows);
+    return PackDisplay(rows, chip.highResolution, texels);
+}
+
+// GLSL 3.30 sources for drawing a packed display, usable by any OpenGL frontend:
+//   vertex    a triangle covering the viewport from gl_VertexID alone, no vertex buffer needed
+//   present   expands the bits texture, or the phosphor intensity texture, through a two colour palette
+//   phosphor  renders the next intensity texture: lit pixels at full brightness, dark ones fading by a factor
+// Uniforms: usampler2D bits (R8UI packed display), ivec2 size (display size in pixels),
+// sampler2D intensity and bool usePhosphor for present, float decay for phosphor, vec3 onColour and offColour.
+extern const char* const DISPLAY_VERTEX_SHADER;
+extern const char* const DISPLAY_PRESENT_SHADER;
+extern const char* const DISPLAY_PHOSPHOR_SHADER;
+
+#ifdef CHIP8_OPENGL
+
+#ifdef CHIP8_GL_HEADER
+#include CHIP8_GL_HEADER //the application's loader, e.g. <glad/gl.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+// OpenGL 3.3 backend: keeps the packed display in a 16 * 64 R8UI texture and draws it at the largest
+// whole-number scale that fits the viewport. With phosphor on, each uploaded frame also renders an
+// intensity texture from the previous one, so pixels that go dark fade out like a CRT.
+// Needs a current context on construction and for every call; built only with CHIP8_OPENGL defined.
+class GpuDisplay
+{
+public:
+    GpuDisplay();
+    ~GpuDisplay();
+    GpuDisplay(GpuDisplay const&) = delete;
+    GpuDisplay& operator=(GpuDisplay const&) = delete;
+
+    bool Ready() const; //false if the shaders didn't compile
+
+    void Upload(Frame const& frame);
+    template <typename Machine>
+    void Upload(Machine const& chip);
+    void Draw(int viewportWidth, int viewportHeight) const; //into the bound framebuffer
+
+    void SetPalette(uint32_t on, uint32_t off); //0xAARRGGBB, alpha ignored
+    void SetPhosphor(float factor); //brightness kept per frame by dark pixels, 0 turns the effect off
+
+private:
+    GLuint bitsTexture = 0;
+    GLuint intensityTextures[2]{};
+    GLuint framebuffer = 0;
+    GLuint vertexArray = 0;
+    GLuint presentProgram = 0;
+    GLuint phosphorProgram = 0;
+    unsigned int current = 0; //intensity texture holding the latest frame
+    int width = 64;
+    int height = 32;
+    float decay = 0.0F;
+    float onColour[3] = {1.0F, 1.0F, 1.0F};
+    float offColour[3] = {0.0F, 0.0F, 0.0F};
+
+    void UploadPacked(uint8_t const* texels, bool highResolution);
+};
+
+/**
+ * @brief Pack and upload a machine's display, typically once per frame.
+ * 
+ * @param chip machine to show, any Chip8Core variant
+ */
+template <typename Machine>
+void GpuDisplay::Upload(Machine const& chip)
+{
+    uint8_t texels[PACKED_DISPLAY_BYTES];
+    PackDisplay(chip, texels);
+    UploadPacked(texels, chip.highResolution);
+}
+
+#endif
@@ -0,0 +1,303 @@
+/**
+ * @file InputLog.cpp
+ * @brief Event encoding, keyframe lookup and the file format of recorded input logs.
+ * 
+ */
+
+#include "InputLog.hpp"
+#include <bit>
+#include <cstring>
+
+const char LOG_MAGIC[4] = {'C', '8', 'I', 'L'};
+const uint8_t LOG_VERSION = 2; //2 added the variant
+const unsigned int MEMORY_SIZE = 4096;
+const unsigned int PAGE_SIZE = 64;
+
+/**
+ * @brief Append an unsigned LEB128 varint.
+ */
+static void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80U)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80U));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * @brief Read an unsigned LEB128 varint.
+ * 
+ * @return false if the varint runs past end
+ */
+static bool GetVarint(uint8_t const*& bytes, uint8_t const* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; bytes < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *bytes++;
+        value |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Write an unsigned LEB128 varint to a stream.
+ */
+static void WriteVarint(std::ostream& out, uint64_t value)
+{
+    std::vector<uint8_t> bytes;
+    PutVarint(bytes, value);
+    out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+}
+
+/**
+ * @brief Read an unsigned LEB128 varint from a stream.
+ * 
+ * @return false if the stream ends first or the varint is too long
+ */
+static bool ReadVarint(std::istream& in, uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        int byte = in.get();
+        if (byte == std::char_traits<char>::eof())
+        {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Construct an empty log.
+ * 
+ * @param keyframeInterval instructions between keyframes, which bounds how far Seek executes
+ */
+InputLog::InputLog(uint64_t keyframeInterval)
+        : keyframeInterval(keyframeInterval)
+{
+}
+
+/**
+ * @brief Drop every event and keyframe.
+ * 
+ */
+void InputLog::Clear()
+{
+    events.clear();
+    keyframes.clear();
+    eventCount = 0;
+    lastEventCycle = 0;
+    nextKeyframe = 0;
+}
+
+size_t InputLog::EventCount() const
+{
+    return eventCount;
+}
+
+size_t InputLog::KeyframeCount() const
+{
+    return keyframes.size();
+}
+
+size_t InputLog::EventBytes() const
+{
+    return events.size();
+}
+
+uint64_t InputLog::EndCycle() const
+{
+    uint64_t end = keyframes.empty() ? 0 : keyframes.back().cycle;
+    return lastEventCycle > end ? lastEventCycle : end;
+}
+
+/**
+ * @brief Encode an event after the last one.
+ * 
+ * @param cycle instruction count the event arrived at, no earlier than the previous event
+ * @param code key and direction, or TIMER_TICK
+ */
+void InputLog::Append(uint64_t cycle, uint8_t code)
+{
+    PutVarint(events, cycle - lastEventCycle);
+    events.push_back(code);
+    lastEventCycle = cycle;
+    eventCount++;
+}
+
+/**
+ * @brief Decode the event at offset.
+ * 
+ * @param offset position in the log, advanced past the event
+ * @param cycle stamp of the previous event, set to this event's
+ * @param code set to the event's code
+ * @return false at the end of the log
+ */
+bool InputLog::NextEvent(size_t& offset, uint64_t& cycle, uint8_t& code) const
+{
+    uint8_t const* bytes = events.data() + offset;
+    uint8_t const* end = events.data() + events.size();
+    uint64_t delta;
+    if (!GetVarint(bytes, end, delta) || bytes == end)
+    {
+        return false;
+    }
+
+    cycle += delta;
+    code = *bytes++;
+    offset = bytes - events.data();
+    return true;
+}
+
+/**
+ * @brief Binary search for the last keyframe at or before an instruction count.
+ * 
+ * @param cycle instruction count
+ * @return the keyframe, or nullptr if every keyframe is later
+ */
+InputLog::Keyframe const* InputLog::FindKeyframe(uint64_t cycle) const
+{
+    auto after = std::upper_bound(keyframes.begin(), keyframes.end(), cycle,
+            [](uint64_t value, Keyframe const& keyframe) { return value < keyframe.cycle; });
+    return after == keyframes.begin() ? nullptr : &*(after - 1);
+}
+
+/**
+ * @brief Write the log as:
+ *   "C8IL", version byte, varint sizeof(MachineState), varint variant, varint keyframeInterval,
+ *   varint event count, varint event bytes, the events,
+ *   varint keyframe count, then for each keyframe varint cycle, offset, event and last event cycle,
+ *   its MachineState as raw bytes and its full 4 kB of memory.
+ * The machine state is stored in host byte order, so logs only move between builds with the same layout,
+ * which the recorded sizeof(MachineState) partly guards. Its padding is always zero, so recordings of
+ * the same session are byte-identical.
+ * 
+ * @param out destination stream
+ * @return false if the stream failed
+ */
+bool InputLog::Write(std::ostream& out) const
+{
+    out.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    out.put(static_cast<char>(LOG_VERSION));
+    WriteVarint(out, sizeof(MachineState));
+    WriteVarint(out, variant);
+    WriteVarint(out, keyframeInterval);
+    WriteVarint(out, eventCount);
+    WriteVarint(out, events.size());
+    out.write(reinterpret_cast<char const*>(events.data()), events.size());
+
+    WriteVarint(out, keyframes.size());
+    for (Keyframe const& keyframe : keyframes)
+    {
+        WriteVarint(out, keyframe.cycle);
+        WriteVarint(out, keyframe.offset);
+        WriteVarint(out, keyframe.event);
+        WriteVarint(out, keyframe.lastEventCycle);
+        out.write(reinterpret_cast<char const*>(&keyframe.snapshot.state), sizeof(MachineState));
+
+        uint8_t memory[MEMORY_SIZE];
+        memcpy(memory, keyframe.snapshot.base->memory, MEMORY_SIZE);
+        const uint8_t* next = keyframe.snapshot.pageData.data();
+        for (uint64_t pages = keyframe.snapshot.pages; pages != 0; pages &= pages - 1)
+        {
+            memcpy(memory + std::countr_zero(pages) * PAGE_SIZE, next, PAGE_SIZE);
+            next += PAGE_SIZE;
+        }
+        out.write(reinterpret_cast<char const*>(memory), MEMORY_SIZE);
+    }
+
+    return static_cast<bool>(out);
+}
+
+/**
+ * @brief Replace the log with one read from a stream written by Write.
+ * Keyframes read back carry no decoded instructions, so replay decodes from memory
+ * until the machine loads a ROM again.
+ * 
+ * @param in source stream
+ * @return false if the stream is truncated, from another version or inconsistent, or a keyframe holds
+ * a state the recorded variant can't be in, leaving the log empty
+ */
+bool InputLog::Read(std::istream& in)
+{
+    Clear();
+
+    char magic[sizeof(LOG_MAGIC)];
+    uint64_t stateSize, stateVariant, interval, count, size;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0 || in.get() != LOG_VERSION
+            || !ReadVarint(in, stateSize) || stateSize != sizeof(MachineState)
+            || !ReadVarint(in, stateVariant) || stateVariant > UINT16_MAX || !ReadVarint(in, interval)
+            || !ReadVarint(in, count) || !ReadVarint(in, size))
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes(size);
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), size))
+    {
+        return false;
+    }
+    events = std::move(bytes);
+
+    //Walk the events once to check them and find where the log ends
+    size_t offset = 0;
+    size_t decoded = 0;
+    uint8_t code;
+    while (NextEvent(offset, lastEventCycle, code))
+    {
+        decoded++;
+    }
+    if (offset != events.size() || decoded != count)
+    {
+        Clear();
+        return false;
+    }
+    eventCount = decoded;
+
+    uint64_t keyframeCount;
+    if (!ReadVarint(in, keyframeCount))
+    {
+        Clear();
+        return false;
+    }
+
+    for (uint64_t i = 0; i < keyframeCount; i++)
+    {
+        uint64_t cycle, eventOffset, event, eventCycle;
+        std::shared_ptr<SnapshotBase> base = std::make_shared<SnapshotBase>();
+        base->modifiedPages = ~0ULL;
+
+        Snapshot snapshot;
+        if (!ReadVarint(in, cycle) || !ReadVarint(in, eventOffset) || !ReadVarint(in, event) || !ReadVarint(in, eventCycle)
+                || !in.read(reinterpret_cast<char*>(&snapshot.state), sizeof(MachineState))
+                || !ValidMachineState(snapshot.state, static_cast<uint16_t>(stateVariant))
+                || !in.read(reinterpret_cast<char*>(base->memory), MEMORY_SIZE)
+                || eventOffset > events.size() || event > eventCount
+                || (!keyframes.empty() && cycle < keyframes.back().cycle))
+        {
+            Clear();
+            return false;
+        }
+        snapshot.base = base;
+
+        keyframes.push_back(Keyframe{cycle, static_cast<size_t>(eventOffset), static_cast<size_t>(event), eventCycle, std::move(snapshot)});
+    }
+
+    variant = static_cast<uint16_t>(stateVariant);
+    keyframeInterval = interval;
+    nextKeyframe = keyframes.empty() ? 0 : keyframes.back().cycle + (interval > 0 ? interval : 1);
+    return true;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Records everything that reaches a machine from outside, key changes and timer ticks, each stamped
+// with the instruction count it arrived at, plus a full snapshot every keyframeInterval instructions.
+// Together with a seeded RND this is enough to rerun a session exactly: Seek restores the last
+// keyframe at or before the target and executes forward from there, feeding the logged inputs back in.
+// A machine with a RandomSource set can't be replayed unless the source is reproducible too.
+//
+// Events are stored as [varint instructions since the previous event][code], where code is the key
+// in the low nibble with bit 4 set for a press, or TIMER_TICK.
+class InputLog
+{
+public:
+    explicit InputLog(uint64_t keyframeInterval = 1 << 20);
+
+    template <typename Machine>
+    void Start(Machine& machine); //clears the log and takes the first keyframe
+    template <typename Machine>
+    void SetKey(Machine& machine, uint8_t key, bool pressed); //changes the keypad and logs it
+    template <typename Machine>
+    void TickTimers(Machine& machine); //ticks the timers and logs it
+    template <typename Machine>
+    void Run(Machine& machine, uint32_t cycles); //runs the machine, taking keyframes on the way
+
+    template <typename Machine>
+    bool Seek(Machine& machine, uint64_t cycle) const; //false if cycle is before the first keyframe or the machine is another variant
+
+    void Clear();
+    size_t EventCount() const;
+    size_t KeyframeCount() const;
+    size_t EventBytes() const;
+    uint64_t EndCycle() const; //instruction count of the last event or keyframe
+
+    bool Write(std::ostream& out) const;
+    bool Read(std::istream& in); //false and left empty if the stream isn't a valid log
+
+    uint64_t keyframeInterval; //instructions between keyframes
+
+    static constexpr uint8_t KEY_PRESSED = 0x10;
+    static constexpr uint8_t TIMER_TICK = 0x20;
+
+private:
+    struct Keyframe
+    {
+        uint64_t cycle;
+        size_t offset; //first byte of events not yet applied to the snapshot
+        size_t event; //number of events before offset
+        uint64_t lastEventCycle; //stamp of the event before offset, the base of the next delta
+        Snapshot snapshot;
+    };
+
+    std::vector<uint8_t> events;
+    std::vector<Keyframe> keyframes;
+    size_t eventCount = 0;
+    uint64_t lastEventCycle = 0;
+    uint64_t nextKeyframe = 0;
+    uint16_t variant = 0; //StateVariant() of the recorded machine
+
+    void Append(uint64_t cycle, uint8_t code);
+    bool NextEvent(size_t& offset, uint64_t& cycle, uint8_t& code) const;
+    Keyframe const* FindKeyframe(uint64_t cycle) const;
+
+    template <typename Machine>
+    void TakeKeyframe(Machine& machine);
+    template <typename Machine>
+    static void Apply(Machine& machine, uint8_t code);
+};
+
+/**
+ * @brief Begin a new recording from the machine's current state.
+ * 
+ * @param machine machine to record, any Chip8Core variant
+ */
+template <typename Machine>
+void InputLog::Start(Machine& machine)
+{
+    Clear();
+    variant = Machine::StateVariant();
+    lastEventCycle = machine.cycleCount;
+    TakeKeyframe(machine);
+}
+
+/**
+ * @brief Press or release a key on the machine, logging the change.
+ * 
+ * @param machine machine being recorded
+ * @param key key 0 through F
+ * @param pressed whether the key is now down
+ */
+template <typename Machine>
+void InputLog::SetKey(Machine& machine, uint8_t key, bool pressed)
+{
+    uint8_t code = (key & 0x0FU) | (pressed ? KEY_PRESSED : 0);
+    Append(machine.cycleCount, code);
+    Apply(machine, code);
+}
+
+/**
+ * @brief Tick the machine's 60 Hz timers, logging the tick.
+ * 
+ * @param machine machine being recorded
+ */
+template <typename Machine>
+void InputLog::TickTimers(Machine& machine)
+{
+    Append(machine.cycleCount, TIMER_TICK);
+    machine.TickTimers();
+}
+
+/**
+ * @brief Execute instructions on the machine being recorded, stopping at each keyframe boundary to take one.
+ * 
+ * @param machine machine being recorded
+ * @param cycles number of instructions to execute
+ */
+template <typename Machine>
+void InputLog::Run(Machine& machine, uint32_t cycles)
+{
+    while (cycles > 0)
+    {
+        uint64_t untilKeyframe = nextKeyframe - machine.cycleCount;
+        uint32_t slice = untilKeyframe < cycles ? static_cast<uint32_t>(untilKeyframe) : cycles;
+        machine.Run(slice);
+        cycles -= slice;
+
+        if (machine.cycleCount >= nextKeyframe)
+        {
+            TakeKeyframe(machine);
+        }
+    }
+}
+
+/**
+ * @brief Put a machine in the state the recorded machine was in after cycle instructions,
+ * with every input logged at that instruction count applied, as it was just before running the next one.
+ * Restores the closest keyframe found by binary search, then executes forward applying the logged inputs,
+ * so the cost is at most keyframeInterval instructions however long the recording is.
+ * 
+ * @param machine machine to replay into, of the same variant as the recording
+ * @param cycle instruction count to seek to
+ * @return false if cycle is before the first keyframe or the machine isn't the recorded variant, 
+ * leaving the machine untouched
+ */
+template <typename Machine>
+bool InputLog::Seek(Machine& machine, uint64_t cycle) const
+{
+    Keyframe const* keyframe = FindKeyframe(cycle);
+    if (!keyframe || Machine::StateVariant() != variant)
+    {
+        return false;
+    }
+
+    machine.Restore(keyframe->snapshot);
+
+    size_t offset = keyframe->offset;
+    uint64_t eventCycle = keyframe->lastEventCycle;
+    uint8_t code;
+    while (NextEvent(offset, eventCycle, code) && eventCycle <= cycle)
+    {
+        while (machine.cycleCount < eventCycle)
+        {
+            uint64_t remaining = eventCycle - machine.cycleCount;
+            machine.Run(static_cast<uint32_t>(std::min<uint64_t>(remaining, UINT32_MAX)));
+        }
+        Apply(machine, code);
+    }
+
+    while (machine.cycleCount < cycle)
+    {
+        uint64_t remaining = cycle - machine.cycleCount;
+        machine.Run(static_cast<uint32_t>(std::min<uint64_t>(remaining, UINT32_MAX)));
+    }
+    return true;
+}
+
+/**
+ * @brief Snapshot the machine and schedule the next keyframe.
+ * 
+ * @param machine machine being recorded
+ */
+template <typename Machine>
+void InputLog::TakeKeyframe(Machine& machine)
+{
+    Keyframe keyframe{machine.cycleCount, events.size(), eventCount, lastEventCycle, machine.TakeSnapshot()};
+    keyframes.push_back(std::move(keyframe));
+    nextKeyframe = machine.cycleCount + (keyframeInterval > 0 ? keyframeInterval : 1);
+}
+
+/**
+ * @brief Feed one logged input to a machine.
+ * 
+ * @param machine machine to change
+ * @param code event code as stored in the log
+ */
+template <typename Machine>
+void InputLog::Apply(Machine& machine, uint8_t code)
+{
+    if (code == TIMER_TICK)
+    {
+        machine.TickTimers();
+    } else
+    {
+        machine.keypad[code & 0x0FU] = (code & KEY_PRESSED) ? 1 : 0;
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file MachinePool.cpp
+ * @brief Pool of machines that are reset in place instead of constructed for every run.
+ * 
+ */
+
+#include "MachinePool.hpp"
+
+template <typename Machine>
+void BasicMachinePool<Machine>::Returner::operator()(Machine* chip) const
+{
+    pool->Return(chip);
+}
+
+template <typename Machine>
+BasicMachinePool<Machine>::~BasicMachinePool()
+{
+    for (Machine* chip : idle)
+    {
+        delete chip;
+    }
+}
+
+/**
+ * @brief Take a machine booted with a ROM, reusing an idle one when there is any.
+ * 
+ * @param rom image from a RomRegistry
+ * @param seed starting point of the machine's random sequence
+ * @param stream selects one of 2^63 independent sequences
+ * @return the machine, in the state Machine(seed, stream) would boot into after LoadROM(rom),
+ * or an empty lease if the ROM is too large
+ */
+template <typename Machine>
+typename BasicMachinePool<Machine>::Lease BasicMachinePool<Machine>::Acquire(RomImage const& rom, uint64_t seed, uint64_t stream)
+{
+    Machine* chip = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!idle.empty())
+        {
+            chip = idle.back();
+            idle.pop_back();
+        }
+    }
+    if (!chip)
+    {
+        chip = new Machine(seed, stream);
+    }
+
+    Lease lease(chip, Returner{this});
+    if (!chip->Reset(rom, seed, stream))
+    {
+        lease.reset();
+    }
+    return lease;
+}
+
+/**
+ * @brief Make sure at least a number of machines are idle, so no Acquire has to construct one.
+ * 
+ * @param machines idle machines wanted
+ */
+template <typename Machine>
+void BasicMachinePool<Machine>::Reserve(size_t machines)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    idle.reserve(machines);
+    while (idle.size() < machines)
+    {
+        idle.push_back(new Machine(0));
+    }
+}
+
+template <typename Machine>
+size_t BasicMachinePool<Machine>::Idle() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return idle.size();
+}
+
+/**
+ * @brief Take back a machine from a lease. It is only reset when acquired again.
+ * 
+ * @param chip machine the lease held
+ */
+template <typename Machine>
+void BasicMachinePool<Machine>::Return(Machine* chip)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    idle.push_back(chip);
+}
+
+template class BasicMachinePool<Chip8>;
+template class BasicMachinePool<CosmacChip8>;
+template class BasicMachinePool<SuperChip8>;
+template class BasicMachinePool<XoChip8>;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <mutex>
+#include <vector>
+
+// Keeps finished machines for reuse, so a farm starting many short runs resets a machine
+// in place instead of allocating and constructing a new one per run.
+// Leases return their machine to the pool when destroyed; the pool must outlive them.
+// Safe to use from several threads. Machine is any Chip8Core variant.
+template <typename Machine>
+class BasicMachinePool
+{
+public:
+    struct Returner
+    {
+        BasicMachinePool* pool;
+        void operator()(Machine* chip) const;
+    };
+
+    typedef std::unique_ptr<Machine, Returner> Lease;
+
+    BasicMachinePool() = default;
+    ~BasicMachinePool();
+    BasicMachinePool(BasicMachinePool const&) = delete;
+    BasicMachinePool& operator=(BasicMachinePool const&) = delete;
+
+    Lease Acquire(RomImage const& rom, uint64_t seed, uint64_t stream = 0); //empty if the ROM doesn't fit
+    void Reserve(size_t machines); //constructs machines up front so Acquire never allocates
+    size_t Idle() const; //machines waiting to be reused
+
+private:
+    mutable std::mutex lock;
+    std::vector<Machine*> idle;
+
+    void Return(Machine* chip);
+};
+
+typedef BasicMachinePool<Chip8> MachinePool;
+
+extern template class BasicMachinePool<Chip8>;
+extern template class BasicMachinePool<CosmacChip8>;
+extern template class BasicMachinePool<SuperChip8>;
+extern template class BasicMachinePool<XoChip8>;
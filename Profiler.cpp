@@ -0,0 +1,126 @@
+/**
+ * @file Profiler.cpp
+ * @brief Per handler and per address instruction profile of a running machine.
+ * 
+ */
+
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+
+Profiler::Profiler()
+    : handlerCounts(Chip8::HandlerCount()), handlerTicks(Chip8::HandlerCount())
+{
+    Reset();
+}
+
+void Profiler::Reset()
+{
+    std::fill(handlerCounts.begin(), handlerCounts.end(), 0);
+    std::fill(handlerTicks.begin(), handlerTicks.end(), 0);
+    std::fill(std::begin(addressCounts), std::end(addressCounts), 0);
+    std::fill(std::begin(addressTicks), std::end(addressTicks), 0);
+    std::fill(std::begin(addressHandlers), std::end(addressHandlers), 0);
+}
+
+uint64_t Profiler::Instructions() const
+{
+    uint64_t total = 0;
+    for (uint64_t count : handlerCounts)
+    {
+        total += count;
+    }
+    return total;
+}
+
+uint64_t Profiler::HandlerCount(uint8_t handler) const
+{
+    return handler < handlerCounts.size() ? handlerCounts[handler] : 0;
+}
+
+uint64_t Profiler::HandlerTicks(uint8_t handler) const
+{
+    return handler < handlerTicks.size() ? handlerTicks[handler] : 0;
+}
+
+uint64_t Profiler::AddressCount(uint16_t address) const
+{
+    return addressCounts[address & 0x0FFFU];
+}
+
+/**
+ * @brief Write a flat profile: every handler that ran, most time first, then the most executed addresses.
+ * 
+ * @param out stream to write to
+ * @param topAddresses number of addresses to list
+ */
+void Profiler::WriteFlat(std::ostream& out, unsigned int topAddresses) const
+{
+    uint64_t instructions = Instructions();
+    uint64_t ticks = 0;
+    std::vector<uint8_t> handlers;
+    for (unsigned int handler = 0; handler < handlerCounts.size(); handler++)
+    {
+        ticks += handlerTicks[handler];
+        if (handlerCounts[handler])
+        {
+            handlers.push_back(static_cast<uint8_t>(handler));
+        }
+    }
+    std::sort(handlers.begin(), handlers.end(), [this](uint8_t a, uint8_t b) { return handlerTicks[a] > handlerTicks[b]; });
+
+    char line[128];
+    snprintf(line, sizeof(line), "%-8s %14s %7s %14s %7s %10s\n", "handler", "count", "count%", "ticks", "ticks%", "ticks/ins");
+    out << line;
+    for (uint8_t handler : handlers)
+    {
+        snprintf(line, sizeof(line), "%-8s %14llu %6.2f%% %14llu %6.2f%% %10.1f\n", Chip8::HandlerName(handler),
+            static_cast<unsigned long long>(handlerCounts[handler]), 100.0 * handlerCounts[handler] / instructions,
+            static_cast<unsigned long long>(handlerTicks[handler]), ticks ? 100.0 * handlerTicks[handler] / ticks : 0.0,
+            static_cast<double>(handlerTicks[handler]) / handlerCounts[handler]);
+        out << line;
+    }
+
+    std::vector<uint16_t> addresses;
+    for (uint16_t address = 0; address < 4096; address++)
+    {
+        if (addressCounts[address])
+        {
+            addresses.push_back(address);
+        }
+    }
+    size_t shown = std::min<size_t>(topAddresses, addresses.size());
+    std::partial_sort(addresses.begin(), addresses.begin() + shown, addresses.end(),
+        [this](uint16_t a, uint16_t b) { return addressCounts[a] > addressCounts[b]; });
+
+    snprintf(line, sizeof(line), "\n%-8s %-8s %14s %7s %14s\n", "address", "handler", "count", "count%", "ticks");
+    out << line;
+    for (size_t i = 0; i < shown; i++)
+    {
+        uint16_t address = addresses[i];
+        snprintf(line, sizeof(line), "0x%03X    %-8s %14llu %6.2f%% %14llu\n", address, Chip8::HandlerName(addressHandlers[address]),
+            static_cast<unsigned long long>(addressCounts[address]), 100.0 * addressCounts[address] / instructions,
+            static_cast<unsigned long long>(addressTicks[address]));
+        out << line;
+    }
+}
+
+/**
+ * @brief Write the profile in the folded stack format read by flamegraph.pl and speedscope, 
+ * one "0xADDRESS;HANDLER ticks" line per executed address, so the graph groups time by handler within each address.
+ * 
+ * @param out stream to write to
+ */
+void Profiler::WriteFolded(std::ostream& out) const
+{
+    char line[64];
+    for (uint16_t address = 0; address < 4096; address++)
+    {
+        if (addressCounts[address])
+        {
+            snprintf(line, sizeof(line), "0x%03X;%s %llu\n", address, Chip8::HandlerName(addressHandlers[address]),
+                static_cast<unsigned long long>(addressTicks[address]));
+            out << line;
+        }
+    }
+}
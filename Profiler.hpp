@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CHIP8_PROFILE_RDTSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define CHIP8_PROFILE_RDTSC
+#endif
+
+// Hooks for Chip8Core::Run(cycles, hooks) counting instructions per handler and per address,
+// and the time spent in each handler, measured in TSC ticks where available and nanoseconds otherwise.
+// Nothing is instrumented unless a machine is run through a Profiler. Works with any Chip8Core variant,
+// since every variant numbers and names its handlers from the same opcode table.
+class Profiler
+{
+public:
+    Profiler();
+
+    template <typename Machine>
+    void Run(Machine& chip, uint32_t cycles);
+    template <typename Machine>
+    static void Runner(Machine& chip, uint32_t cycles, void* profiler); //for BasicScheduler::SetRunner
+    void Reset();
+
+    uint64_t Instructions() const;
+    uint64_t HandlerCount(uint8_t handler) const;
+    uint64_t HandlerTicks(uint8_t handler) const;
+    uint64_t AddressCount(uint16_t address) const;
+
+    void WriteFlat(std::ostream& out, unsigned int topAddresses = 20) const; //table per handler, then the hottest addresses
+    void WriteFolded(std::ostream& out) const; //"address;handler ticks" lines for flamegraph.pl
+
+    template <typename Machine>
+    bool BeforeInstruction(Machine& chip, uint16_t address)
+    {
+        (void)chip;
+        (void)address;
+        start = Now();
+        return true;
+    }
+
+    template <typename Machine>
+    void AfterInstruction(Machine& chip, uint16_t address)
+    {
+        uint64_t ticks = Now() - start;
+        uint8_t handler = chip.CurrentInstruction().handler;
+        handlerCounts[handler]++;
+        handlerTicks[handler] += ticks;
+        addressCounts[address]++;
+        addressTicks[address] += ticks;
+        addressHandlers[address] = handler;
+    }
+
+private:
+    uint64_t start = 0;
+    std::vector<uint64_t> handlerCounts;
+    std::vector<uint64_t> handlerTicks;
+    uint64_t addressCounts[4096];
+    uint64_t addressTicks[4096];
+    uint8_t addressHandlers[4096]; //handler last executed at each address
+
+    static uint64_t Now();
+};
+
+/**
+ * @brief Execute instructions on a machine, recording each of them in the profile.
+ * 
+ * @param chip machine to run, any Chip8Core variant
+ * @param cycles number of instructions to execute
+ */
+template <typename Machine>
+void Profiler::Run(Machine& chip, uint32_t cycles)
+{
+    chip.Run(cycles, *this);
+}
+
+template <typename Machine>
+void Profiler::Runner(Machine& chip, uint32_t cycles, void* profiler)
+{
+    static_cast<Profiler*>(profiler)->Run(chip, cycles);
+}
+
+inline uint64_t Profiler::Now()
+{
+#ifdef CHIP8_PROFILE_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
@@ -0,0 +1,449 @@
+/**
+ * @file RegressionTests.cpp
+ * @brief Regression tests for interpreter behaviour that display hashes alone don't pin down.
+ * 
+ * Usage: regressiontests
+ * Every test boots a small program, runs it and checks registers, memory or counters.
+ * Failed checks are printed and the exit status is 1 if any test fails.
+ * 
+ */
+
+#include "AsyncChip8.hpp"
+#include "Chip8.hpp"
+#include "Chip8Lockstep.hpp"
+#include "InputLog.hpp"
+#include "Profiler.hpp"
+#include "RomAnalysis.hpp"
+#include "Scheduler.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// Checks that failed in the current test
+unsigned int failures = 0;
+
+/**
+ * @brief Record one check of a test.
+ * 
+ * @param ok whether the check passed
+ * @param what description printed when it didn't
+ */
+static void Check(bool ok, char const* what)
+{
+    if (!ok)
+    {
+        printf("    failed: %s\n", what);
+        failures++;
+    }
+}
+
+/**
+ * @brief Boot a machine with a program given as bytes.
+ * 
+ * @param chip machine to load, any Chip8Core variant
+ * @param program bytes placed at the start address
+ */
+template <typename Machine>
+static void Boot(Machine& chip, std::initializer_list<uint8_t> program)
+{
+    std::vector<uint8_t> rom(program);
+    chip.LoadROM(std::span<const uint8_t>(rom.data(), rom.size()));
+}
+
+/**
+ * @brief A lane run in lockstep counts its instructions like a plain machine, vector steps included.
+ */
+static void LockstepCountsCycles()
+{
+    //ALU and jump loop that only ever takes the vector path
+    std::initializer_list<uint8_t> program = {0x60, 0x01, 0x70, 0x01, 0x81, 0x04, 0x12, 0x02};
+
+    Chip8Lockstep lockstep(4);
+    for (size_t lane = 0; lane < lockstep.Size(); lane++)
+    {
+        Boot(lockstep[lane], program);
+    }
+    Chip8 chip(0);
+    Boot(chip, program);
+
+    lockstep.Run(1001);
+    chip.Run(1001);
+
+    Check(lockstep.vectorInstructions != 0, "program runs through the vector path");
+    for (size_t lane = 0; lane < lockstep.Size(); lane++)
+    {
+        Check(lockstep[lane].cycleCount == chip.cycleCount, "lane cycleCount matches a plain machine");
+        Check(lockstep[lane].opcode == chip.opcode, "lane opcode matches a plain machine");
+        Check(lockstep[lane].registers[1] == chip.registers[1], "lane registers match a plain machine");
+    }
+}
+
+// Program ending in an ALU instruction with x = F, and the flag VF must hold afterwards
+struct FlagCase
+{
+    char const* what;
+    std::initializer_list<uint8_t> program;
+    uint8_t flag;
+};
+
+/**
+ * @brief 8XY4 to 8XYE write VF last, so with x = F the flag survives, in every variant and in lockstep.
+ */
+static void FlagWrittenLast()
+{
+    const FlagCase cases[] =
+    {
+        {"8FF6 keeps the shifted out bit", {0x6F, 0x81, 0x8F, 0xF6}, 1},
+        {"8FF6 keeps a clear shifted out bit", {0x6F, 0x02, 0x8F, 0xF6}, 0},
+        {"8FFE keeps the shifted out bit", {0x6F, 0x81, 0x8F, 0xFE}, 1},
+        {"8FFE keeps a clear shifted out bit", {0x6F, 0x40, 0x8F, 0xFE}, 0},
+        {"8FE4 keeps the carry", {0x6F, 0xFF, 0x6E, 0x02, 0x8F, 0xE4}, 1},
+        {"8FE5 keeps not borrow", {0x6F, 0x05, 0x6E, 0x02, 0x8F, 0xE5}, 1},
+        {"8FE7 keeps not borrow", {0x6F, 0x05, 0x6E, 0x02, 0x8F, 0xE7}, 0}
+    };
+
+    for (FlagCase const& test : cases)
+    {
+        uint32_t steps = static_cast<uint32_t>(test.program.size() / 2);
+
+        Chip8 chip(0);
+        CosmacChip8 cosmac(0);
+        SuperChip8 superChip(0);
+        Chip8Lockstep lockstep(2);
+        Boot(chip, test.program);
+        Boot(cosmac, test.program);
+        Boot(superChip, test.program);
+        Boot(lockstep[0], test.program);
+        Boot(lockstep[1], test.program);
+        chip.Run(steps);
+        cosmac.Run(steps);
+        superChip.Run(steps);
+        lockstep.Run(steps);
+
+        bool ok = chip.registers[0xF] == test.flag && cosmac.registers[0xF] == test.flag
+                && superChip.registers[0xF] == test.flag && lockstep[0].registers[0xF] == test.flag;
+        Check(ok, test.what);
+    }
+}
+
+/**
+ * @brief Whether a machine's keypad, display and memory outside the program are still as booted,
+ * the state that follows the stack and would be hit by a stack pointer running off its end.
+ * 
+ * @param chip machine to check
+ * @param programSize bytes of the program at the start address
+ * @return true if nothing past the stack was written
+ */
+static bool PastStackUntouched(Chip8 const& chip, size_t programSize)
+{
+    Chip8 fresh(0);
+    bool untouched = true;
+    for (unsigned int key = 0; key < 16; key++)
+    {
+        untouched &= chip.keypad[key] == 0;
+    }
+    for (unsigned int row = 0; row < Chip8::DISPLAY_ROWS; row++)
+    {
+        untouched &= chip.display[row][0] == 0;
+    }
+    for (size_t address = 0x200 + programSize; address < 4096; address++)
+    {
+        untouched &= chip.memory[address] == fresh.memory[address];
+    }
+    return untouched;
+}
+
+/**
+ * @brief Calls nested past 16 levels and returns with an empty stack wrap within the stack.
+ */
+static void StackPointerWraps()
+{
+    //2200 calls itself forever
+    Chip8 deep(0);
+    Boot(deep, {0x22, 0x00});
+    deep.Run(17);
+    Check(deep.sp == 17 % 16, "17 nested calls wrap the stack pointer");
+    Check(PastStackUntouched(deep, 2), "17 nested calls stay inside the stack");
+
+    //00EE with nothing on the stack returns to 202, which calls itself forever
+    Chip8 stray(0);
+    Boot(stray, {0x00, 0xEE, 0x22, 0x02});
+    stray.stack[0] = 0x202;
+    stray.Run(1);
+    Check(stray.sp == 15 && stray.pcRegister == 0x202, "00EE at sp 0 wraps to the top entry");
+    stray.Run(3);
+    Check(stray.sp == 2, "calls after a stray return wrap back to the bottom");
+    Check(PastStackUntouched(stray, 4), "calls after a stray return stay inside the stack");
+}
+
+/**
+ * @brief Any variant can be profiled, with the same handler numbering as Chip8.
+ */
+static void ProfilesEveryVariant()
+{
+    //00FF switches SUPER-CHIP to high resolution and is unknown to plain CHIP-8
+    std::initializer_list<uint8_t> program = {0x00, 0xFF, 0x60, 0x01, 0x12, 0x02};
+
+    Profiler profiler;
+    SuperChip8 superChip(0);
+    Boot(superChip, program);
+    profiler.Run(superChip, 101);
+    Check(profiler.Instructions() == 101, "SUPER-CHIP instructions are all counted");
+    Check(superChip.highResolution, "SUPER-CHIP runs its own handlers under the profiler");
+
+    profiler.Reset();
+    XoChip8 xoChip(0);
+    Boot(xoChip, program);
+    BasicScheduler<XoChip8> scheduler(xoChip, 600);
+    scheduler.SetRunner(&Profiler::Runner<XoChip8>, &profiler);
+    scheduler.RunFrame();
+    Check(profiler.Instructions() == xoChip.cycleCount, "XO-CHIP profiled through the scheduler counts every instruction");
+}
+
+/**
+ * @brief FX75 and FX85 clamp x to 7 rather than wrapping, so x = 8 and 15 save and restore V0 to V7.
+ */
+static void RplFlagsClamp()
+{
+    for (uint8_t x : {7, 8, 15})
+    {
+        //Fill V0 to VF with 1 to 16, save V0 to Vx, clear V0 to VF, then restore V0 to Vx
+        std::vector<uint8_t> rom;
+        for (uint8_t r = 0; r < 16; r++)
+        {
+            rom.insert(rom.end(), {static_cast<uint8_t>(0x60U | r), static_cast<uint8_t>(r + 1U)});
+        }
+        rom.insert(rom.end(), {static_cast<uint8_t>(0xF0U | x), 0x75});
+        for (uint8_t r = 0; r < 16; r++)
+        {
+            rom.insert(rom.end(), {static_cast<uint8_t>(0x60U | r), 0x00});
+        }
+        rom.insert(rom.end(), {static_cast<uint8_t>(0xF0U | x), 0x85});
+
+        SuperChip8 chip(0);
+        chip.LoadROM(std::span<const uint8_t>(rom.data(), rom.size()));
+        chip.Run(static_cast<uint32_t>(rom.size() / 2));
+
+        bool saved = true;
+        for (uint8_t r = 0; r < 16; r++)
+        {
+            saved &= chip.registers[r] == (r < 8 ? r + 1 : 0);
+        }
+        for (uint8_t flag = 0; flag < 8; flag++)
+        {
+            saved &= chip.rplFlags[flag] == flag + 1;
+        }
+        Check(saved, x == 7 ? "F775 and F785 move V0 to V7" : x == 8 ? "F875 and F885 clamp to V0 to V7" : "FF75 and FF85 clamp to V0 to V7");
+    }
+}
+
+/**
+ * @brief Record a short session with keyframes, a key press and timer ticks.
+ * 
+ * @param garbage byte left on the stack beforehand, so uninitialised bytes would differ between calls
+ * @return the written log
+ */
+static std::string RecordSession(uint8_t garbage)
+{
+    volatile uint8_t scribble[16384];
+    memset(const_cast<uint8_t*>(scribble), garbage, sizeof(scribble));
+
+    Chip8 chip(1);
+    Boot(chip, {0x60, 0x3C, 0xF0, 0x15, 0xC1, 0xFF, 0xF2, 0x0A, 0x12, 0x04});
+    InputLog log(64);
+    log.Start(chip);
+    for (unsigned int frame = 0; frame < 20; frame++)
+    {
+        log.Run(chip, 30);
+        log.TickTimers(chip);
+        log.SetKey(chip, 5, frame == 10);
+    }
+
+    std::ostringstream out;
+    log.Write(out);
+    return out.str();
+}
+
+/**
+ * @brief Two recordings of the same session write byte-identical logs, padding included.
+ */
+static void InputLogsAreDeterministic()
+{
+    std::string first = RecordSession(0x00);
+    std::string second = RecordSession(0xA5);
+    Check(!first.empty() && first == second, "the same session gives the same log bytes");
+}
+
+/**
+ * @brief A log read back is only replayed into the variant that recorded it, and a log whose keyframes
+ * hold an impossible state is refused when read.
+ */
+static void InputLogsAreValidated()
+{
+    //SUPER-CHIP in high resolution, drawing so a plain CHIP-8 display would be overrun
+    SuperChip8 superChip(1);
+    Boot(superChip, {0x00, 0xFF, 0x60, 0x3F, 0x61, 0x3C, 0xD0, 0x14, 0x12, 0x06});
+    InputLog recording(64);
+    recording.Start(superChip);
+    recording.Run(superChip, 500);
+    std::ostringstream out;
+    recording.Write(out);
+    std::string bytes = out.str();
+
+    InputLog log;
+    std::istringstream in(bytes);
+    Check(log.Read(in), "a SUPER-CHIP log reads back");
+    Chip8 chip(0);
+    Check(!log.Seek(chip, 450), "a SUPER-CHIP log doesn't replay into CHIP-8");
+    Check(chip.pcRegister == 0x200 && !chip.highResolution, "a refused seek leaves the machine unchanged");
+    SuperChip8 replay(0);
+    Check(log.Seek(replay, 450) && replay.highResolution && replay.cycleCount == 450, "a SUPER-CHIP log replays into SUPER-CHIP");
+
+    //Corrupt the last keyframe's state, which sits just before its 4 kB of memory at the end of the log
+    size_t state = bytes.size() - 4096 - sizeof(MachineState);
+    const std::pair<size_t, char> corruptions[] =
+    {
+        {offsetof(MachineState, highResolution), 2},
+        {offsetof(MachineState, sp), 16}
+    };
+    for (auto const& [field, value] : corruptions)
+    {
+        std::string corrupt = bytes;
+        corrupt[state + field] = value;
+        std::istringstream corruptIn(corrupt);
+        Check(!log.Read(corruptIn) && log.KeyframeCount() == 0, field == offsetof(MachineState, sp) ? "a keyframe with sp past the stack is refused" : "a keyframe with highResolution of 2 is refused");
+    }
+}
+
+/**
+ * @brief Run frames forever, as a host's per-user session would.
+ * 
+ * @param session session to run
+ */
+static Chip8Task PlayForever(AsyncChip8& session)
+{
+    for (;;)
+    {
+        co_await session.RunUntilFrame();
+    }
+}
+
+/**
+ * @brief A task destroyed while suspended in FX0A detaches from its session, and a session destroyed
+ * first detaches from its task, so neither touches the other's freed memory.
+ */
+static void DroppedTasksDetach()
+{
+    //LD V0, K: waits for a key with no timers running, so the session suspends
+    Chip8 chip(0);
+    Boot(chip, {0xF0, 0x0A, 0x12, 0x00});
+    AsyncChip8 session(chip);
+    {
+        Chip8Task task = PlayForever(session);
+        Check(session.Suspended(), "a session in FX0A suspends its task");
+    }
+    Check(!session.Suspended(), "destroying a suspended task detaches it from the session");
+    session.PressKey(5);
+    Check(chip.keypad[5] == 1, "a key press after the task is gone resumes nothing");
+
+    Chip8 other(0);
+    Boot(other, {0xF0, 0x0A, 0x12, 0x00});
+    std::optional<AsyncChip8> shortSession(std::in_place, other);
+    Chip8Task task = PlayForever(*shortSession);
+    shortSession.reset();
+    Check(!task.Done(), "a task outlives its session until destroyed");
+}
+
+/**
+ * @brief The disassembler decodes through the interpreter's dispatch table and names every handler it has.
+ */
+static void DisassemblerCoversHandlers()
+{
+    unsigned int mismatches = 0;
+    for (unsigned int op = 0; op <= 0xFFFFU; op++)
+    {
+        bool unknown = Chip8::HandlerOf(static_cast<uint16_t>(op)) == 0;
+        bool word = RomAnalysis::Disassemble(static_cast<uint16_t>(op)).rfind("DW ", 0) == 0;
+        mismatches += word != unknown;
+    }
+    Check(mismatches == 0, "exactly the opcodes without a handler disassemble as DW");
+    Check(RomAnalysis::Disassemble(0x8FE4U) == "ADD VF, VE", "8XY4 disassembles as ADD");
+    Check(RomAnalysis::Disassemble(0x5121U) == "DW 0x5121", "5XY1 has no handler");
+}
+
+/**
+ * @brief A state image is trusted only as far as it can be checked: impossible states are refused
+ * and leave the machine as it was, and pc and I are masked to 12 bits as the interpreter masks them.
+ */
+static void StateImagesAreValidated()
+{
+    Chip8 source(0);
+    Boot(source, {0x60, 0x2A, 0x12, 0x02});
+    source.Run(1);
+    StateImage good;
+    source.SaveImage(good);
+
+    //highResolution corrupted to a byte that isn't a bool, or set on a machine without SUPER-CHIP
+    for (uint8_t highResolution : {2, 1})
+    {
+        StateImage bad = good;
+        reinterpret_cast<uint8_t*>(&bad.state)[offsetof(MachineState, highResolution)] = highResolution;
+        Chip8 chip(0);
+        Check(!chip.Restore(bad), highResolution == 2 ? "highResolution of 2 is refused" : "highResolution on plain CHIP-8 is refused");
+        Check(chip.registers[0] == 0 && chip.pcRegister == 0x200, "a refused image leaves the machine unchanged");
+    }
+
+    StateImage deep = good;
+    deep.state.sp = 16;
+    Chip8 chip(0);
+    Check(!chip.Restore(deep), "sp past the stack is refused");
+
+    StateImage wide = good;
+    wide.state.pcRegister = 0xF202;
+    wide.state.indexRegister = 0xFFFF;
+    Check(chip.Restore(wide), "pc and I past memory are accepted");
+    Check(chip.pcRegister == 0x202 && chip.indexRegister == 0xFFF, "pc and I are masked to 12 bits");
+    chip.Run(1);
+    Check(chip.pcRegister == 0x202 && chip.registers[0] == 0x2A, "the masked image runs as the original");
+}
+
+// A regression test and the name it is reported under
+struct RegressionTest
+{
+    char const* name;
+    void (*run)();
+};
+
+const RegressionTest regressionTests[] =
+{
+    {"lockstep counts cycles", LockstepCountsCycles},
+    {"flag written last", FlagWrittenLast},
+    {"stack pointer wraps", StackPointerWraps},
+    {"profiles every variant", ProfilesEveryVariant},
+    {"RPL flags clamp", RplFlagsClamp},
+    {"input logs are deterministic", InputLogsAreDeterministic},
+    {"input logs are validated", InputLogsAreValidated},
+    {"dropped tasks detach", DroppedTasksDetach},
+    {"disassembler covers handlers", DisassemblerCoversHandlers},
+    {"state images are validated", StateImagesAreValidated}
+};
+
+int main()
+{
+    unsigned int failed = 0;
+    for (RegressionTest const& test : regressionTests)
+    {
+        failures = 0;
+        test.run();
+        printf("%s %s\n", failures == 0 ? "pass" : "FAIL", test.name);
+        failed += failures != 0;
+    }
+
+    printf("%u of %zu tests failed\n", failed, sizeof(regressionTests) / sizeof(regressionTests[0]));
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,639 @@
+/**
+ * @file RomAnalysis.cpp
+ * @brief Disassembly, control-flow graph construction and write tracking for CHIP-8 ROMs.
+ * 
+ */
+
+#include "RomAnalysis.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+const uint16_t ENTRY_POINT = 0x200;
+const unsigned int MEMORY_SIZE = 4096;
+const unsigned int PAGE_SHIFT = 6;
+const unsigned int DATA_BYTES_PER_LINE = 8;
+const int32_t INDEX_UNREACHED = -2; //dataflow value of a block no path has reached yet
+const int32_t INDEX_UNKNOWN = -1; //dataflow value of I when paths disagree
+
+// Disassembly of the handler for an opcode pattern, named as in Chip8::HandlerName. In format, %x and %y
+// are the register nibbles, %k the low byte, %n the low nibble and %a the low 12 bits.
+// Which pattern an opcode belongs to comes from the interpreter's own dispatch table, never from here.
+struct Mnemonic
+{
+    char const* pattern;
+    char const* format;
+    FlowKind flow;
+};
+
+const Mnemonic mnemonics[] =
+{
+    {"00E0", "CLS", FlowKind::Next},
+    {"00EE", "RET", FlowKind::Return},
+    {"00CN", "SCD %n", FlowKind::Next},
+    {"00FB", "SCR", FlowKind::Next},
+    {"00FC", "SCL", FlowKind::Next},
+    {"00FD", "EXIT", FlowKind::Exit},
+    {"00FE", "LOW", FlowKind::Next},
+    {"00FF", "HIGH", FlowKind::Next},
+    {"1NNN", "JP %a", FlowKind::Jump},
+    {"2NNN", "CALL %a", FlowKind::Call},
+    {"3XKK", "SE V%x, %k", FlowKind::Skip},
+    {"4XKK", "SNE V%x, %k", FlowKind::Skip},
+    {"5XY0", "SE V%x, V%y", FlowKind::Skip},
+    {"6XKK", "LD V%x, %k", FlowKind::Next},
+    {"7XKK", "ADD V%x, %k", FlowKind::Next},
+    {"8XY0", "LD V%x, V%y", FlowKind::Next},
+    {"8XY1", "OR V%x, V%y", FlowKind::Next},
+    {"8XY2", "AND V%x, V%y", FlowKind::Next},
+    {"8XY3", "XOR V%x, V%y", FlowKind::Next},
+    {"8XY4", "ADD V%x, V%y", FlowKind::Next},
+    {"8XY5", "SUB V%x, V%y", FlowKind::Next},
+    {"8XY6", "SHR V%x, V%y", FlowKind::Next},
+    {"8XY7", "SUBN V%x, V%y", FlowKind::Next},
+    {"8XYE", "SHL V%x, V%y", FlowKind::Next},
+    {"9XY0", "SNE V%x, V%y", FlowKind::Skip},
+    {"ANNN", "LD I, %a", FlowKind::Next},
+    {"BNNN", "JP V0, %a", FlowKind::IndirectJump},
+    {"CXKK", "RND V%x, %k", FlowKind::Next},
+    {"DXYN", "DRW V%x, V%y, %n", FlowKind::Next},
+    {"EX9E", "SKP V%x", FlowKind::Skip},
+    {"EXA1", "SKNP V%x", FlowKind::Skip},
+    {"FX07", "LD V%x, DT", FlowKind::Next},
+    {"FX0A", "LD V%x, K", FlowKind::Next},
+    {"FX15", "LD DT, V%x", FlowKind::Next},
+    {"FX18", "LD ST, V%x", FlowKind::Next},
+    {"FX1E", "ADD I, V%x", FlowKind::Next},
+    {"FX29", "LD F, V%x", FlowKind::Next},
+    {"FX30", "LD HF, V%x", FlowKind::Next},
+    {"FX33", "LD B, V%x", FlowKind::Next},
+    {"FX55", "LD [I], V%x", FlowKind::Next},
+    {"FX65", "LD V%x, [I]", FlowKind::Next},
+    {"FX75", "LD R, V%x", FlowKind::Next},
+    {"FX85", "LD V%x, R", FlowKind::Next}
+};
+
+/**
+ * @brief Match every handler of the interpreter with its mnemonic by pattern name, once.
+ * 
+ * @return mnemonic of each handler index, nullptr for the catch-all and any handler without one
+ */
+static std::vector<Mnemonic const*> MnemonicsByHandler()
+{
+    std::vector<Mnemonic const*> byHandler(Chip8::HandlerCount(), nullptr);
+    for (unsigned int handler = 1; handler < byHandler.size(); handler++)
+    {
+        for (Mnemonic const& mnemonic : mnemonics)
+        {
+            if (strcmp(mnemonic.pattern, Chip8::HandlerName(static_cast<uint8_t>(handler))) == 0)
+            {
+                byHandler[handler] = &mnemonic;
+            }
+        }
+    }
+    return byHandler;
+}
+
+/**
+ * @brief Find the mnemonic for an opcode, decoded by the interpreter's dispatch table.
+ * 
+ * @return the mnemonic, or nullptr for opcodes the interpreter treats as no-ops
+ */
+static Mnemonic const* FindMnemonic(uint16_t opcode)
+{
+    static const std::vector<Mnemonic const*> byHandler = MnemonicsByHandler();
+    return byHandler[Chip8::HandlerOf(opcode)];
+}
+
+/**
+ * @brief Lay the ROM out in memory the way Chip8::LoadROM does, fonts included, and analyse it.
+ * 
+ * @param rom program bytes, loaded at 0x200
+ */
+RomAnalysis::RomAnalysis(std::span<const uint8_t> rom)
+{
+    Chip8 chip(0);
+    if (!chip.LoadROM(rom))
+    {
+        return;
+    }
+
+    memcpy(memory, chip.memory, sizeof(memory));
+    romSize = rom.size();
+    loaded = true;
+
+    FindInstructions();
+    BuildBlocks();
+    TrackWrites();
+}
+
+bool RomAnalysis::Loaded() const
+{
+    return loaded;
+}
+
+/**
+ * @brief Disassemble one instruction.
+ * Opcodes the interpreter doesn't implement come out as DW with their value.
+ * 
+ * @param opcode instruction to disassemble
+ * @return the mnemonic and operands
+ */
+std::string RomAnalysis::Disassemble(uint16_t opcode)
+{
+    Mnemonic const* mnemonic = FindMnemonic(opcode);
+    if (!mnemonic)
+    {
+        char word[16];
+        snprintf(word, sizeof(word), "DW 0x%04X", opcode);
+        return word;
+    }
+
+    std::string text;
+    for (char const* c = mnemonic->format; *c != '\0'; c++)
+    {
+        if (*c != '%')
+        {
+            text += *c;
+            continue;
+        }
+
+        char operand[8];
+        switch (*++c)
+        {
+        case 'x':
+            snprintf(operand, sizeof(operand), "%X", (opcode >> 8U) & 0x0FU);
+            break;
+        case 'y':
+            snprintf(operand, sizeof(operand), "%X", (opcode >> 4U) & 0x0FU);
+            break;
+        case 'k':
+            snprintf(operand, sizeof(operand), "0x%02X", opcode & 0x00FFU);
+            break;
+        case 'n':
+            snprintf(operand, sizeof(operand), "%u", opcode & 0x000FU);
+            break;
+        default:
+            snprintf(operand, sizeof(operand), "0x%03X", opcode & 0x0FFFU);
+            break;
+        }
+        text += operand;
+    }
+    return text;
+}
+
+/**
+ * @brief How an instruction passes control on.
+ * 
+ * @param opcode instruction to classify
+ * @return its kind of control flow, Next for opcodes the interpreter treats as no-ops
+ */
+FlowKind RomAnalysis::Flow(uint16_t opcode)
+{
+    Mnemonic const* mnemonic = FindMnemonic(opcode);
+    return mnemonic ? mnemonic->flow : FlowKind::Next;
+}
+
+std::vector<AnalyzedBlock> const& RomAnalysis::Blocks() const
+{
+    return blocks;
+}
+
+/**
+ * @brief Binary search for the block covering an address.
+ * 
+ * @param address any byte of an instruction
+ * @return the last block starting at or before address that reaches it, or nullptr
+ */
+AnalyzedBlock const* RomAnalysis::BlockAt(uint16_t address) const
+{
+    auto after = std::upper_bound(blocks.begin(), blocks.end(), address,
+            [](uint16_t value, AnalyzedBlock const& block) { return value < block.start; });
+    if (after == blocks.begin() || address >= (after - 1)->start + (after - 1)->length)
+    {
+        return nullptr;
+    }
+    return &*(after - 1);
+}
+
+std::vector<MemoryWrite> const& RomAnalysis::Writes() const
+{
+    return writes;
+}
+
+bool RomAnalysis::IsInstruction(uint16_t address) const
+{
+    return instructions.test(address & (MEMORY_SIZE - 1));
+}
+
+bool RomAnalysis::HasIndirectJumps() const
+{
+    return indirectJumps;
+}
+
+bool RomAnalysis::HasUnknownWrites() const
+{
+    return std::any_of(writes.begin(), writes.end(), [](MemoryWrite const& write) { return !write.known; });
+}
+
+uint64_t RomAnalysis::CodePages() const
+{
+    uint64_t pages = 0;
+    for (unsigned int address = 0; address < MEMORY_SIZE; address++)
+    {
+        if (codeBytes.test(address))
+        {
+            pages |= 1ULL << (address >> PAGE_SHIFT);
+        }
+    }
+    return pages;
+}
+
+uint64_t RomAnalysis::WrittenPages() const
+{
+    uint64_t pages = 0;
+    for (MemoryWrite const& write : writes)
+    {
+        if (!write.known)
+        {
+            return ~0ULL;
+        }
+        for (unsigned int i = 0; i < write.length; i++)
+        {
+            pages |= 1ULL << (((write.start + i) & (MEMORY_SIZE - 1)) >> PAGE_SHIFT);
+        }
+    }
+    return pages;
+}
+
+uint64_t RomAnalysis::SelfModifyingPages() const
+{
+    return CodePages() & WrittenPages();
+}
+
+/**
+ * @brief Read the big-endian opcode at an address, wrapping at the end of memory like the interpreter.
+ * 
+ */
+uint16_t RomAnalysis::Opcode(uint16_t address) const
+{
+    return static_cast<uint16_t>((memory[address & (MEMORY_SIZE - 1)] << 8U) | memory[(address + 1U) & (MEMORY_SIZE - 1)]);
+}
+
+/**
+ * @brief Mark every instruction reachable from the entry point, following each kind of control flow.
+ * A call is assumed to return, so the instruction after it is reachable too.
+ * 
+ * @effects instructions, codeBytes and indirectJumps
+ */
+void RomAnalysis::FindInstructions()
+{
+    std::vector<uint16_t> pending = {ENTRY_POINT};
+    while (!pending.empty())
+    {
+        uint16_t address = pending.back();
+        pending.pop_back();
+
+        while (!instructions.test(address))
+        {
+            instructions.set(address);
+            codeBytes.set(address);
+            codeBytes.set((address + 1U) & (MEMORY_SIZE - 1));
+
+            uint16_t opcode = Opcode(address);
+            uint16_t next = (address + 2U) & (MEMORY_SIZE - 1);
+            FlowKind flow = Flow(opcode);
+            if (flow == FlowKind::Jump)
+            {
+                next = opcode & 0x0FFFU;
+            } else if (flow == FlowKind::Call)
+            {
+                pending.push_back(opcode & 0x0FFFU);
+            } else if (flow == FlowKind::Skip)
+            {
+                pending.push_back((address + 4U) & (MEMORY_SIZE - 1));
+            } else if (flow != FlowKind::Next)
+            {
+                indirectJumps = indirectJumps || flow == FlowKind::IndirectJump;
+                break;
+            }
+            address = next;
+        }
+    }
+}
+
+/**
+ * @brief Split the reachable instructions into basic blocks and link them.
+ * A block starts at the entry point, at every branch target and after every instruction
+ * that doesn't simply fall through.
+ * 
+ * @effects blocks
+ */
+void RomAnalysis::BuildBlocks()
+{
+    std::bitset<MEMORY_SIZE> leaders;
+    leaders.set(ENTRY_POINT);
+    for (unsigned int address = 0; address < MEMORY_SIZE; address++)
+    {
+        if (!instructions.test(address))
+        {
+            continue;
+        }
+
+        uint16_t opcode = Opcode(address);
+        FlowKind flow = Flow(opcode);
+        if (flow == FlowKind::Jump || flow == FlowKind::Call)
+        {
+            leaders.set(opcode & 0x0FFFU);
+        }
+        if (flow == FlowKind::Skip)
+        {
+            leaders.set((address + 4U) & (MEMORY_SIZE - 1));
+        }
+        if (flow != FlowKind::Next)
+        {
+            leaders.set((address + 2U) & (MEMORY_SIZE - 1));
+        }
+    }
+
+    for (unsigned int start = 0; start < MEMORY_SIZE; start++)
+    {
+        if (!leaders.test(start) || !instructions.test(start))
+        {
+            continue;
+        }
+
+        AnalyzedBlock block{static_cast<uint16_t>(start), 0, FlowKind::Next, {}};
+        uint16_t address = static_cast<uint16_t>(start);
+        for (;;)
+        {
+            block.length += 2;
+            block.exit = Flow(Opcode(address));
+            uint16_t next = (address + 2U) & (MEMORY_SIZE - 1);
+            if (block.exit != FlowKind::Next || leaders.test(next) || !instructions.test(next) || block.length >= MEMORY_SIZE)
+            {
+                break;
+            }
+            address = next;
+        }
+
+        uint16_t opcode = Opcode(address);
+        uint16_t next = (address + 2U) & (MEMORY_SIZE - 1);
+        switch (block.exit)
+        {
+        case FlowKind::Next:
+            if (instructions.test(next))
+            {
+                block.successors.push_back(next);
+            }
+            break;
+        case FlowKind::Jump:
+            block.successors.push_back(opcode & 0x0FFFU);
+            break;
+        case FlowKind::Call:
+            block.successors.push_back(opcode & 0x0FFFU);
+            block.successors.push_back(next);
+            break;
+        case FlowKind::Skip:
+            block.successors.push_back(next);
+            block.successors.push_back((address + 4U) & (MEMORY_SIZE - 1));
+            break;
+        default:
+            break;
+        }
+        blocks.push_back(std::move(block));
+    }
+
+    for (AnalyzedBlock const& block : blocks)
+    {
+        for (uint16_t successor : block.successors)
+        {
+            if (successor <= block.start)
+            {
+                auto target = std::lower_bound(blocks.begin(), blocks.end(), successor,
+                        [](AnalyzedBlock const& candidate, uint16_t value) { return candidate.start < value; });
+                if (target != blocks.end() && target->start == successor)
+                {
+                    target->loopHeader = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Work out the value of I along every path by dataflow over the blocks, then record each FX33
+ * and FX55 with the range it writes. I is only known after LD I, addr; anything else that changes it,
+ * a return from a call, or paths that disagree make it unknown.
+ * FX55 and FX65 make I unknown too, since some variants advance it.
+ * 
+ * @effects writes, and selfModifying on blocks overlapping a known write
+ */
+void RomAnalysis::TrackWrites()
+{
+    std::vector<int32_t> entryIndex(blocks.size(), INDEX_UNREACHED);
+    auto indexOf = [this](uint16_t start)
+    {
+        return std::lower_bound(blocks.begin(), blocks.end(), start,
+                [](AnalyzedBlock const& block, uint16_t value) { return block.start < value; }) - blocks.begin();
+    };
+
+    //Runs the block's instructions over a value of I, reporting each memory write
+    auto simulate = [this](AnalyzedBlock const& block, int32_t index, auto&& onWrite)
+    {
+        for (uint16_t offset = 0; offset < block.length; offset += 2)
+        {
+            uint16_t address = (block.start + offset) & (MEMORY_SIZE - 1);
+            uint16_t opcode = Opcode(address);
+            if ((opcode & 0xF000U) == 0xA000U)
+            {
+                index = opcode & 0x0FFFU;
+            } else if ((opcode & 0xF0FFU) == 0xF033U)
+            {
+                onWrite(address, index, 3);
+            } else if ((opcode & 0xF0FFU) == 0xF055U)
+            {
+                onWrite(address, index, ((opcode >> 8U) & 0x0FU) + 1);
+                index = INDEX_UNKNOWN;
+            } else if ((opcode & 0xF0FFU) == 0xF065U || (opcode & 0xF0FFU) == 0xF01EU
+                    || (opcode & 0xF0FFU) == 0xF029U || (opcode & 0xF0FFU) == 0xF030U)
+            {
+                index = INDEX_UNKNOWN;
+            }
+        }
+        return index;
+    };
+
+    std::vector<size_t> pending;
+    if (!blocks.empty() && blocks[indexOf(ENTRY_POINT)].start == ENTRY_POINT)
+    {
+        entryIndex[indexOf(ENTRY_POINT)] = 0;
+        pending.push_back(indexOf(ENTRY_POINT));
+    }
+
+    while (!pending.empty())
+    {
+        size_t current = pending.back();
+        pending.pop_back();
+
+        AnalyzedBlock const& block = blocks[current];
+        int32_t index = simulate(block, entryIndex[current], [](uint16_t, int32_t, unsigned int) {});
+        for (size_t s = 0; s < block.successors.size(); s++)
+        {
+            //The callee may change I before returning
+            int32_t value = block.exit == FlowKind::Call && s == 1 ? INDEX_UNKNOWN : index;
+            size_t target = indexOf(block.successors[s]);
+            int32_t merged = entryIndex[target] == INDEX_UNREACHED || entryIndex[target] == value ? value : INDEX_UNKNOWN;
+            if (merged != entryIndex[target])
+            {
+                entryIndex[target] = merged;
+                pending.push_back(target);
+            }
+        }
+    }
+
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        if (entryIndex[b] == INDEX_UNREACHED)
+        {
+            continue;
+        }
+
+        simulate(blocks[b], entryIndex[b], [this](uint16_t site, int32_t index, unsigned int length)
+        {
+            MemoryWrite write{site, 0, static_cast<uint16_t>(length), index >= 0, false};
+            if (write.known)
+            {
+                write.start = static_cast<uint16_t>(index);
+                for (unsigned int i = 0; i < length; i++)
+                {
+                    write.hitsCode = write.hitsCode || codeBytes.test((index + i) & (MEMORY_SIZE - 1));
+                }
+            }
+            writes.push_back(write);
+        });
+    }
+    std::sort(writes.begin(), writes.end(), [](MemoryWrite const& a, MemoryWrite const& b) { return a.site < b.site; });
+
+    for (MemoryWrite const& write : writes)
+    {
+        if (!write.hitsCode)
+        {
+            continue;
+        }
+        for (AnalyzedBlock& block : blocks)
+        {
+            for (unsigned int i = 0; i < write.length; i++)
+            {
+                uint16_t address = (write.start + i) & (MEMORY_SIZE - 1);
+                block.selfModifying = block.selfModifying || (address >= block.start && address < block.start + block.length);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Write a text listing: a summary of the pages, then every block with its instructions
+ * and the ROM bytes between blocks as data.
+ * 
+ * @param out destination
+ */
+void RomAnalysis::WriteListing(std::ostream& out) const
+{
+    char line[128];
+    snprintf(line, sizeof(line), "; code pages %016llx, written pages %016llx, self-modifying pages %016llx\n",
+            static_cast<unsigned long long>(CodePages()), static_cast<unsigned long long>(WrittenPages()),
+            static_cast<unsigned long long>(SelfModifyingPages()));
+    out << line;
+    if (indirectJumps)
+    {
+        out << "; has indirect jumps, code only reached through them is not listed\n";
+    }
+    for (MemoryWrite const& write : writes)
+    {
+        if (!write.known)
+        {
+            snprintf(line, sizeof(line), "; 0x%03X writes through an unknown I\n", write.site);
+            out << line;
+        } else if (write.hitsCode)
+        {
+            snprintf(line, sizeof(line), "; 0x%03X writes over code at 0x%03X\n", write.site, write.start);
+            out << line;
+        }
+    }
+
+    unsigned int address = 0;
+    unsigned int romEnd = ENTRY_POINT + static_cast<unsigned int>(romSize);
+    auto writeData = [&](unsigned int end)
+    {
+        address = std::max(address, static_cast<unsigned int>(ENTRY_POINT));
+        while (address < end)
+        {
+            int length = snprintf(line, sizeof(line), "%03X        DB", address);
+            for (unsigned int i = 0; i < DATA_BYTES_PER_LINE && address < end; i++, address++)
+            {
+                length += snprintf(line + length, sizeof(line) - length, " 0x%02X", memory[address]);
+            }
+            out << line << '\n';
+        }
+    };
+
+    for (AnalyzedBlock const& block : blocks)
+    {
+        writeData(std::min(static_cast<unsigned int>(block.start), romEnd));
+
+        int length = snprintf(line, sizeof(line), "\n; block 0x%03X", block.start);
+        for (size_t s = 0; s < block.successors.size(); s++)
+        {
+            length += snprintf(line + length, sizeof(line) - length, "%s0x%03X", s == 0 ? " -> " : ", ", block.successors[s]);
+        }
+        out << line << (block.loopHeader ? " [loop]" : "") << (block.selfModifying ? " [self-modifying]" : "")
+                << (block.start < address ? " [overlaps previous block]" : "") << '\n';
+
+        for (uint16_t offset = 0; offset < block.length; offset += 2)
+        {
+            uint16_t at = (block.start + offset) & (MEMORY_SIZE - 1);
+            uint16_t opcode = Opcode(at);
+            snprintf(line, sizeof(line), "%03X  %04X  ", at, opcode);
+            out << line << Disassemble(opcode) << '\n';
+        }
+        address = std::max(address, static_cast<unsigned int>(block.start + block.length));
+    }
+
+    if (address < romEnd)
+    {
+        out << '\n';
+    }
+    writeData(romEnd);
+}
+
+/**
+ * @brief Write the control-flow graph in Graphviz DOT. Each block is a node holding its disassembly;
+ * return edges after calls are dashed, loop headers drawn bold and self-modified blocks red.
+ * 
+ * @param out destination
+ */
+void RomAnalysis::WriteDot(std::ostream& out) const
+{
+    char line[128];
+    out << "digraph rom {\n    node [shape=box, fontname=monospace];\n";
+    for (AnalyzedBlock const& block : blocks)
+    {
+        snprintf(line, sizeof(line), "    b%03X [label=\"", block.start);
+        out << line;
+        for (uint16_t offset = 0; offset < block.length; offset += 2)
+        {
+            uint16_t at = (block.start + offset) & (MEMORY_SIZE - 1);
+            snprintf(line, sizeof(line), "%03X  ", at);
+            out << line << Disassemble(Opcode(at)) << "\\l";
+        }
+        out << '"' << (block.loopHeader ? ", style=bold" : "") << (block.selfModifying ? ", color=red" : "") << "];\n";
+
+        for (size_t s = 0; s < block.successors.size(); s++)
+        {
+            snprintf(line, sizeof(line), "    b%03X -> b%03X", block.start, block.successors[s]);
+            out << line << (block.exit == FlowKind::Call && s == 1 ? " [style=dashed]" : "") << ";\n";
+        }
+    }
+    out << "}\n";
+}
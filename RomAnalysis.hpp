@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <bitset>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// How an instruction passes control on
+enum class FlowKind : uint8_t
+{
+    Next, //falls through to the following instruction
+    Jump, //JP addr
+    Call, //CALL addr, returning to the following instruction
+    Return, //RET, to wherever the caller was
+    Skip, //SE, SNE, SKP and SKNP go to one of the next two instructions
+    IndirectJump, //JP V0, addr, target depends on a register
+    Exit //SUPER-CHIP EXIT
+};
+
+// Straight run of instructions entered only at the top and left only from the last instruction
+struct AnalyzedBlock
+{
+    uint16_t start;
+    uint16_t length; //bytes
+    FlowKind exit; //how the last instruction leaves the block
+    std::vector<uint16_t> successors; //blocks control can reach next, for a call the target then the return site
+    bool loopHeader = false; //target of a backward branch, where hot code usually is
+    bool selfModifying = false; //an instruction with a known I writes over part of it
+};
+
+// FX33 or FX55 writing memory
+struct MemoryWrite
+{
+    uint16_t site; //address of the instruction
+    uint16_t start; //first byte written, if known
+    uint16_t length; //bytes written
+    bool known; //I holds the same value on every path to the instruction
+    bool hitsCode; //a written byte is part of an instruction
+};
+
+// Static analysis of a ROM laid out in memory as Chip8::LoadROM does: the instructions reachable from
+// the entry point, their basic blocks and control-flow graph, and which memory the program writes.
+// Control flow is followed through jumps, calls, returns and skips; JP V0, addr is not followed, so code
+// only reachable through it is left out, as is code only reachable through memory the program writes.
+// Write addresses come from tracking I through LD I, addr along every path. The code, data and
+// self-modifying page sets are reports for the disassembler and other tools; the interpreter doesn't read
+// them, since it already marks every page written at run time and decodes those pages from memory.
+class RomAnalysis
+{
+public:
+    explicit RomAnalysis(std::span<const uint8_t> rom);
+
+    bool Loaded() const; //false if the ROM doesn't fit in memory, leaving the analysis empty
+
+    static std::string Disassemble(uint16_t opcode); //mnemonic as in Chip8.hpp, such as "DRW V0, V1, 5"
+    static FlowKind Flow(uint16_t opcode);
+
+    std::vector<AnalyzedBlock> const& Blocks() const; //in address order
+    AnalyzedBlock const* BlockAt(uint16_t address) const; //block whose instructions cover address, or nullptr
+    std::vector<MemoryWrite> const& Writes() const; //in address order
+    bool IsInstruction(uint16_t address) const; //a reachable instruction starts at address
+    bool HasIndirectJumps() const;
+    bool HasUnknownWrites() const; //some write's address couldn't be worked out
+
+    uint64_t CodePages() const; //bit n set if 64 byte page n holds reachable instructions
+    uint64_t WrittenPages() const; //pages the program may write, all of them if a write is unknown
+    uint64_t SelfModifyingPages() const; //pages holding code the program may write
+
+    void WriteListing(std::ostream& out) const; //disassembly by block, with data between blocks as bytes
+    void WriteDot(std::ostream& out) const; //Graphviz control-flow graph
+
+private:
+    uint8_t memory[4096]{};
+    size_t romSize = 0;
+    bool loaded = false;
+    std::bitset<4096> instructions; //addresses where a reachable instruction starts
+    std::bitset<4096> codeBytes; //bytes of reachable instructions
+    std::vector<AnalyzedBlock> blocks;
+    std::vector<MemoryWrite> writes;
+    bool indirectJumps = false;
+
+    uint16_t Opcode(uint16_t address) const;
+    void FindInstructions();
+    void BuildBlocks();
+    void TrackWrites();
+};
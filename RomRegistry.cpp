@@ -0,0 +1,234 @@
+/**
+ * @file RomRegistry.cpp
+ * @brief Memory-mapped ROM files and a registry that shares decoded ROMs between machines.
+ * 
+ */
+
+#include "RomRegistry.hpp"
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+/**
+ * @brief Map a file read-only. Empty files open successfully with no bytes.
+ * 
+ * @param filename path of the file
+ */
+MappedFile::MappedFile(char const* filename)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize))
+    {
+        size = static_cast<size_t>(fileSize.QuadPart);
+        open = true;
+        if (size > 0)
+        {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            open = data != nullptr;
+        }
+    }
+    CloseHandle(file);
+#else
+    int file = ::open(filename, O_RDONLY);
+    if (file < 0)
+    {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) == 0)
+    {
+        size = static_cast<size_t>(info.st_size);
+        open = true;
+        if (size > 0)
+        {
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+            data = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+            open = data != nullptr;
+        }
+    }
+    ::close(file);
+#endif
+
+    if (!open)
+    {
+        size = 0;
+    }
+}
+
+/**
+ * @brief Unmap the file.
+ * 
+ */
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping)
+    {
+        CloseHandle(mapping);
+    }
+#else
+    if (data)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+}
+
+bool MappedFile::IsOpen() const
+{
+    return open;
+}
+
+std::span<const uint8_t> MappedFile::Bytes() const
+{
+    return std::span<const uint8_t>(data, size);
+}
+
+/**
+ * @brief 64-bit FNV-1a hash of a ROM's contents.
+ * 
+ * @param rom contents of the ROM
+ * @return the hash
+ */
+uint64_t RomRegistry::Hash(std::span<const uint8_t> rom)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (uint8_t byte : rom)
+    {
+        hash = (hash ^ byte) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Map a ROM file and register it, or return the handle from an earlier load of the same path.
+ * The mapping stays open for as long as the handle is alive, so the bytes are never copied.
+ * 
+ * @param filename path of the ROM
+ * @return the shared ROM, or nullptr if the file can't be read or doesn't fit in memory
+ */
+RomHandle RomRegistry::Load(char const* filename)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::unordered_map<std::string, RomHandle>::const_iterator found = byPath.find(filename);
+        if (found != byPath.end())
+        {
+            return found->second;
+        }
+    }
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(filename);
+    if (!file->IsOpen())
+    {
+        return nullptr;
+    }
+
+    RomHandle rom = Intern(file->Bytes(), file);
+    if (rom)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        byPath[filename] = rom;
+    }
+    return rom;
+}
+
+/**
+ * @brief Register a copy of a ROM held in memory.
+ * 
+ * @param rom contents of the ROM
+ * @return the shared ROM, or nullptr if it doesn't fit in memory
+ */
+RomHandle RomRegistry::Add(std::span<const uint8_t> rom)
+{
+    std::shared_ptr<std::vector<uint8_t>> copy = std::make_shared<std::vector<uint8_t>>(rom.begin(), rom.end());
+    return Intern(std::span<const uint8_t>(copy->data(), copy->size()), copy);
+}
+
+/**
+ * @brief Return the registered ROM with these contents, registering and decoding it first if it is new.
+ * 
+ * @param rom contents of the ROM
+ * @param storage owner of the bytes rom points to
+ * @return the shared ROM, or nullptr if it doesn't fit in memory
+ */
+RomHandle RomRegistry::Intern(std::span<const uint8_t> rom, std::shared_ptr<const void> storage)
+{
+    uint64_t hash = Hash(rom);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::unordered_map<uint64_t, RomHandle>::const_iterator found = byHash.find(hash);
+        if (found != byHash.end())
+        {
+            std::span<const uint8_t> existing = found->second->bytes;
+            if (existing.size() == rom.size() && (rom.empty() || memcmp(existing.data(), rom.data(), rom.size()) == 0))
+            {
+                return found->second;
+            }
+        }
+    }
+
+    std::shared_ptr<const DecodedProgram> decoded = Chip8::Predecode(rom);
+    if (!decoded)
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<RomImage> image = std::make_shared<RomImage>();
+    image->bytes = rom;
+    image->hash = hash;
+    image->decoded = decoded;
+    image->storage = storage;
+
+    //Another thread may have registered it meanwhile, keep whichever got there first
+    std::lock_guard<std::mutex> guard(lock);
+    std::pair<std::unordered_map<uint64_t, RomHandle>::iterator, bool> inserted = byHash.emplace(hash, image);
+    if (inserted.second)
+    {
+        return image;
+    }
+
+    //A different ROM with the same hash is handed out unshared
+    std::span<const uint8_t> existing = inserted.first->second->bytes;
+    bool same = existing.size() == rom.size() && (rom.empty() || memcmp(existing.data(), rom.data(), rom.size()) == 0);
+    return same ? inserted.first->second : RomHandle(image);
+}
+
+size_t RomRegistry::Size() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return byHash.size();
+}
+
+void RomRegistry::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    byHash.clear();
+    byPath.clear();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Chip8.hpp"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    explicit MappedFile(char const* filename);
+    ~MappedFile();
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool IsOpen() const;
+    std::span<const uint8_t> Bytes() const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    bool open = false;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+};
+
+// Shares one decoded copy of every ROM between all the machines that load it.
+// ROMs are keyed by content hash, so the same ROM under two paths is only stored once.
+class RomRegistry
+{
+public:
+    RomHandle Load(char const* filename); //nullptr if unreadable or too large, each path is read once
+    RomHandle Add(std::span<const uint8_t> rom); //copies rom, nullptr if too large
+    size_t Size() const; //number of distinct ROMs
+    void Clear(); //handles already given out stay valid
+
+    static uint64_t Hash(std::span<const uint8_t> rom);
+
+private:
+    mutable std::mutex lock;
+    std::unordered_map<uint64_t, RomHandle> byHash;
+    std::unordered_map<std::string, RomHandle> byPath;
+
+    RomHandle Intern(std::span<const uint8_t> rom, std::shared_ptr<const void> storage);
+};
@@ -0,0 +1,245 @@
+/**
+ * @file Scheduler.cpp
+ * @brief Runs a Chip-8 machine of any variant at a configurable clock rate with 60 Hz timers.
+ * 
+ */
+
+#include "Scheduler.hpp"
+#include <thread>
+
+const uint64_t TIMER_HZ = 60;
+const unsigned int SLICES_PER_FRAME = 4; //real time mode wakes this often per frame to keep input latency low
+const uint64_t MAX_FRAMES_BEHIND = 6; //real time mode stops catching up past this and resynchronises
+const uint32_t IDLE_CHECK_INTERVAL = 256; //instructions between checks for idle loops
+
+/**
+ * @brief Attach a scheduler to a machine.
+ * 
+ * @param chip machine to run
+ * @param clockRate instructions per second
+ * @param mode pacing to use
+ */
+template <typename Machine>
+BasicScheduler<Machine>::BasicScheduler(Machine& chip, uint32_t clockRate, SchedulerMode mode)
+        : chip(chip), clockRate(clockRate > 0 ? clockRate : 1), mode(mode)
+{
+}
+
+template <typename Machine>
+void BasicScheduler<Machine>::SetClockRate(uint32_t instructionsPerSecond)
+{
+    clockRate = instructionsPerSecond > 0 ? instructionsPerSecond : 1;
+}
+
+template <typename Machine>
+uint32_t BasicScheduler<Machine>::ClockRate() const
+{
+    return clockRate;
+}
+
+/**
+ * @brief Switch pacing. Real time pacing restarts from the current wall time.
+ * 
+ * @param mode pacing to use
+ */
+template <typename Machine>
+void BasicScheduler<Machine>::SetMode(SchedulerMode mode)
+{
+    this->mode = mode;
+    paced = false;
+}
+
+template <typename Machine>
+SchedulerMode BasicScheduler<Machine>::Mode() const
+{
+    return mode;
+}
+
+template <typename Machine>
+uint64_t BasicScheduler<Machine>::FrameCount() const
+{
+    return frameCount;
+}
+
+/**
+ * @brief The timers tick when cycleCount crosses a multiple of clockRate / 60, 
+ * so tick k is due once ceil(k * clockRate / 60) instructions have run.
+ * 
+ * @return cycleCount at which the next tick is due
+ */
+template <typename Machine>
+uint64_t BasicScheduler<Machine>::NextTickCycle() const
+{
+    uint64_t nextTick = chip.cycleCount * TIMER_HZ / clockRate + 1;
+    return (nextTick * clockRate + TIMER_HZ - 1) / TIMER_HZ;
+}
+
+template <typename Machine>
+void BasicScheduler<Machine>::AttachInput(KeyEventQueue* queue)
+{
+    input = queue;
+}
+
+template <typename Machine>
+void BasicScheduler<Machine>::AttachFrames(FrameExchange* exchange)
+{
+    frameExchange = exchange;
+    publishedGeneration = ~0ULL;
+}
+
+/**
+ * @brief Apply every key event posted since the last call to the keypad.
+ * 
+ * @effects chip.keypad by setting each posted key's state
+ */
+template <typename Machine>
+void BasicScheduler<Machine>::DeliverInput()
+{
+    KeyEvent event;
+    while (input && input->Pop(event))
+    {
+        chip.keypad[event.key & 0x0FU] = event.pressed ? 1 : 0;
+    }
+}
+
+template <typename Machine>
+void BasicScheduler<Machine>::SetRunner(RunFunction function, void* context)
+{
+    runner = function;
+    runnerContext = context;
+}
+
+template <typename Machine>
+void BasicScheduler<Machine>::Execute(uint32_t cycles)
+{
+    if (runner)
+    {
+        runner(chip, cycles, runnerContext);
+    } else
+    {
+        chip.Run(cycles);
+    }
+}
+
+template <typename Machine>
+void BasicScheduler<Machine>::SetIdleSkipping(bool enabled)
+{
+    idleSkipping = enabled;
+}
+
+template <typename Machine>
+uint64_t BasicScheduler<Machine>::SkippedCycles() const
+{
+    return skippedCycles;
+}
+
+/**
+ * @brief Execute instructions until the machine's cycleCount reaches a target.
+ * Every IDLE_CHECK_INTERVAL instructions the machine is checked for an idle loop. 
+ * A timer loop can't end before the frame does, so it is skipped to the end of the frame; 
+ * a key wait only to the target, since input arrives between calls.
+ * 
+ * @param cycle target cycleCount
+ * @param frameEnd cycleCount of the next timer tick
+ */
+template <typename Machine>
+void BasicScheduler<Machine>::RunTo(uint64_t cycle, uint64_t frameEnd)
+{
+    while (chip.cycleCount < cycle)
+    {
+        uint64_t remaining = cycle - chip.cycleCount;
+        if (!idleSkipping)
+        {
+            Execute(remaining > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(remaining));
+            continue;
+        }
+
+        Execute(remaining > IDLE_CHECK_INTERVAL ? IDLE_CHECK_INTERVAL : static_cast<uint32_t>(remaining));
+        IdleState idle = chip.cycleCount < cycle ? chip.DetectIdle() : IdleState::Running;
+        if (idle != IdleState::Running)
+        {
+            uint64_t skipTo = idle == IdleState::WaitingForKey ? cycle : frameEnd;
+            skippedCycles += skipTo - chip.cycleCount;
+            chip.FastForward(skipTo);
+        }
+    }
+}
+
+/**
+ * @brief Execute one frame: every instruction up to the next timer tick, then the tick.
+ * In real time mode the frame is spread over 1/60 s in a few slices, 
+ * and the tick lands on the frame's steady_clock deadline.
+ * 
+ * @effects chip by running it and ticking its timers once
+ * @effects the attached FrameExchange by publishing the display if it changed
+ */
+template <typename Machine>
+void BasicScheduler<Machine>::RunFrame()
+{
+    uint64_t tickCycle = NextTickCycle();
+
+    if (mode == SchedulerMode::RealTime)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!paced)
+        {
+            epoch = now;
+            realTimeFrames = 0;
+            paced = true;
+        }
+
+        std::chrono::steady_clock::time_point frameStart = epoch + std::chrono::nanoseconds(realTimeFrames * 1000000000ULL / TIMER_HZ);
+        std::chrono::steady_clock::time_point frameEnd = epoch + std::chrono::nanoseconds((realTimeFrames + 1) * 1000000000ULL / TIMER_HZ);
+
+        //After a long stall, start counting from now instead of racing to catch up
+        if (now - frameEnd > std::chrono::nanoseconds(MAX_FRAMES_BEHIND * 1000000000ULL / TIMER_HZ))
+        {
+            epoch = now;
+            realTimeFrames = 0;
+            frameStart = now;
+            frameEnd = now + std::chrono::nanoseconds(1000000000ULL / TIMER_HZ);
+        }
+
+        uint64_t frameStartCycle = chip.cycleCount;
+        for (unsigned int slice = 1; slice <= SLICES_PER_FRAME; slice++)
+        {
+            DeliverInput();
+            RunTo(frameStartCycle + (tickCycle - frameStartCycle) * slice / SLICES_PER_FRAME, tickCycle);
+            std::this_thread::sleep_until(frameStart + (frameEnd - frameStart) * slice / SLICES_PER_FRAME);
+        }
+
+        realTimeFrames++;
+    } else
+    {
+        DeliverInput();
+        RunTo(tickCycle, tickCycle);
+    }
+
+    chip.TickTimers();
+    frameCount++;
+
+    if (frameExchange && chip.DisplayGeneration() != publishedGeneration)
+    {
+        publishedGeneration = chip.DisplayGeneration();
+        frameExchange->Publish(chip);
+    }
+}
+
+/**
+ * @brief Execute several frames back to back.
+ * 
+ * @param frames number of frames
+ */
+template <typename Machine>
+void BasicScheduler<Machine>::RunFrames(uint32_t frames)
+{
+    while (frames--)
+    {
+        RunFrame();
+    }
+}
+
+template class BasicScheduler<Chip8>;
+template class BasicScheduler<CosmacChip8>;
+template class BasicScheduler<SuperChip8>;
+template class BasicScheduler<XoChip8>;
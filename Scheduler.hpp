@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Channels.hpp"
+#include <chrono>
+
+// How the Scheduler paces a machine
+enum class SchedulerMode
+{
+    Unthrottled, //as fast as possible
+    RealTime //instructions spread over wall time, timers tick every 1/60 s
+};
+
+// Runs a machine at a fixed instruction rate and ticks its timers at 60 Hz.
+// Timer ticks fall on instruction counts derived from cycleCount in both modes, so a run
+// is deterministic and identical however fast it executes; RealTime mode only adds pacing.
+// A machine found idle is skipped straight to the end of its frame, or of its slice while
+// it waits for a key. Input and frames cross threads only between slices, never inside Run.
+// Machine is any Chip8Core variant.
+template <typename Machine>
+class BasicScheduler
+{
+public:
+    // Executes instructions in place of Machine::Run, to run a machine under a profiler or debugger
+    typedef void (*RunFunction)(Machine& chip, uint32_t cycles, void* context);
+
+    explicit BasicScheduler(Machine& chip, uint32_t clockRate = 700, SchedulerMode mode = SchedulerMode::Unthrottled);
+
+    void SetClockRate(uint32_t instructionsPerSecond);
+    uint32_t ClockRate() const;
+    void SetMode(SchedulerMode mode);
+    SchedulerMode Mode() const;
+
+    void RunFrame(); //execute up to the next timer tick, then tick
+    void RunFrames(uint32_t frames);
+    uint64_t FrameCount() const; //frames run by this scheduler
+
+    uint64_t NextTickCycle() const; //cycleCount at which the timers next tick
+
+    void AttachInput(KeyEventQueue* queue); //applied to keypad between slices, nullptr detaches
+    void AttachFrames(FrameExchange* exchange); //published after frames that changed the display, nullptr detaches
+
+    void SetRunner(RunFunction runner, void* context); //nullptr restores Machine::Run
+
+    void SetIdleSkipping(bool enabled); //on by default
+    uint64_t SkippedCycles() const; //instructions skipped over idle loops
+
+private:
+    Machine& chip;
+    uint32_t clockRate;
+    SchedulerMode mode;
+    uint64_t frameCount = 0;
+    bool idleSkipping = true;
+    uint64_t skippedCycles = 0;
+    KeyEventQueue* input = nullptr;
+    FrameExchange* frameExchange = nullptr;
+    uint64_t publishedGeneration = ~0ULL;
+    RunFunction runner = nullptr;
+    void* runnerContext = nullptr;
+
+    std::chrono::steady_clock::time_point epoch; //wall time of realTimeFrames == 0
+    uint64_t realTimeFrames = 0; //frames run since epoch
+    bool paced = false; //epoch is valid
+
+    void RunTo(uint64_t cycle, uint64_t frameEnd);
+    void DeliverInput();
+    void Execute(uint32_t cycles);
+};
+
+typedef BasicScheduler<Chip8> Scheduler;
+
+extern template class BasicScheduler<Chip8>;
+extern template class BasicScheduler<CosmacChip8>;
+extern template class BasicScheduler<SuperChip8>;
+extern template class BasicScheduler<XoChip8>;
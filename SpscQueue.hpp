@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size lock-free queue for exactly one producer thread and one consumer thread.
+// Each side caches the other's index and only rereads it when the queue looks full or empty.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer only. Returns false, dropping item, if the queue is full
+    bool Push(T const& item)
+    {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headCache == Capacity)
+        {
+            headCache = headIndex.load(std::memory_order_acquire);
+            if (tail - headCache == Capacity)
+            {
+                return false;
+            }
+        }
+
+        items[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false if the queue is empty
+    bool Pop(T& item)
+    {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailCache)
+        {
+            tailCache = tailIndex.load(std::memory_order_acquire);
+            if (head == tailCache)
+            {
+                return false;
+            }
+        }
+
+        item = items[head & (Capacity - 1)];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> headIndex{0}; //next item to pop, written by the consumer
+    size_t tailCache = 0; //consumer's copy of tailIndex
+    alignas(64) std::atomic<size_t> tailIndex{0}; //next free slot, written by the producer
+    size_t headCache = 0; //producer's copy of headIndex
+    alignas(64) T items[Capacity];
+};
@@ -0,0 +1,354 @@
+/**
+ * @file StreamEncoder.cpp
+ * @brief Run length and delta encoding of frames and beeper edges into a ring buffer.
+ * 
+ */
+
+#include "StreamEncoder.hpp"
+#include <bit>
+#include <cstring>
+
+const unsigned int ROWS = 64;
+const unsigned int WORD_BITS = 64;
+const uint8_t SOUND_FLAG = 1;
+const uint8_t HIGH_RESOLUTION_FLAG = 2;
+
+/**
+ * @brief Append an unsigned LEB128 varint.
+ */
+static void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80U)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80U));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * @brief Read an unsigned LEB128 varint.
+ * 
+ * @return false if the varint runs past end
+ */
+static bool GetVarint(uint8_t const*& bytes, uint8_t const* end, uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; bytes < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *bytes++;
+        value |= static_cast<uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Append the alternating off/on runs of the pixels in rows, leftmost pixel first.
+ * Runs are measured a word at a time by counting leading zeros or ones.
+ * 
+ * @param rows rows of up to 128 pixels, leftmost in bit 63 of the first word
+ * @param count number of rows
+ * @param words words of each row to encode, 1 or 2
+ */
+static void PutRuns(std::vector<uint8_t>& out, uint64_t const (*rows)[2], unsigned int count, unsigned int words)
+{
+    bool on = false;
+    uint64_t run = 0;
+
+    for (unsigned int index = 0; index < count * words; index++)
+    {
+        uint64_t word = rows[index / words][index % words];
+        unsigned int left = WORD_BITS;
+        while (left)
+        {
+            unsigned int same = on ? std::countl_one(word) : std::countl_zero(word);
+            if (same > left)
+            {
+                same = left;
+            }
+            run += same;
+            left -= same;
+            word = same == WORD_BITS ? 0 : word << same;
+            if (left)
+            {
+                PutVarint(out, run);
+                run = 0;
+                on = !on;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fill rows from alternating off/on runs; pixels after the last run belong to the final run.
+ * 
+ * @param words words of each row the runs cover, the rest of each row is cleared
+ * @return false if the runs are malformed
+ */
+static bool GetRuns(uint8_t const* bytes, uint8_t const* end, uint64_t (*rows)[2], unsigned int count, unsigned int words)
+{
+    unsigned int rowBits = words * WORD_BITS;
+    unsigned int total = count * rowBits;
+    unsigned int position = 0;
+    bool on = false;
+
+    memset(rows, 0, count * sizeof(rows[0]));
+    while (position < total)
+    {
+        uint64_t run = total - position;
+        if (bytes < end && (!GetVarint(bytes, end, run) || run > total - position))
+        {
+            return false;
+        }
+        if (on)
+        {
+            for (unsigned int bit = position; bit < position + run; bit++)
+            {
+                unsigned int column = bit % rowBits;
+                rows[bit / rowBits][column / WORD_BITS] |= 1ULL << (WORD_BITS - 1 - column % WORD_BITS);
+            }
+        }
+        position += static_cast<unsigned int>(run);
+        on = !on;
+    }
+    return bytes == end;
+}
+
+StreamRing::StreamRing(size_t capacity)
+    : buffer(std::bit_ceil(capacity < 2 ? 2 : capacity)), mask(buffer.size() - 1)
+{
+}
+
+bool StreamRing::Write(uint8_t const* bytes, size_t length)
+{
+    size_t end = tail.load(std::memory_order_relaxed);
+    if (buffer.size() - (end - head.load(std::memory_order_acquire)) < length)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        buffer[(end + i) & mask] = bytes[i];
+    }
+    tail.store(end + length, std::memory_order_release);
+    return true;
+}
+
+size_t StreamRing::Read(uint8_t* bytes, size_t maxLength)
+{
+    size_t start = head.load(std::memory_order_relaxed);
+    size_t available = tail.load(std::memory_order_acquire) - start;
+    size_t length = available < maxLength ? available : maxLength;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        bytes[i] = buffer[(start + i) & mask];
+    }
+    head.store(start + length, std::memory_order_release);
+    return length;
+}
+
+size_t StreamRing::Capacity() const
+{
+    return buffer.size();
+}
+
+StreamEncoder::StreamEncoder(StreamRing& ring, uint32_t keyframeInterval)
+    : ring(ring), keyframeInterval(keyframeInterval)
+{
+}
+
+/**
+ * @brief Encode a frame as a delta of the rows that changed, or as a keyframe if one is due or shorter.
+ * 
+ * @param display rows of the frame, as Chip8::display
+ * @param highResolution whether the frame is 128 * 64
+ * @param cycle cycleCount of the frame
+ */
+void StreamEncoder::EncodeFrame(uint64_t const display[64][2], bool highResolution, uint64_t cycle)
+{
+    unsigned int height = highResolution ? 64 : 32;
+    unsigned int words = highResolution ? 2 : 1;
+
+    uint64_t changed[ROWS][2];
+    uint64_t rowMask = 0;
+    unsigned int changedCount = 0;
+    for (unsigned int row = 0; row < height; row++)
+    {
+        changed[changedCount][0] = display[row][0] ^ previous[row][0];
+        changed[changedCount][1] = (display[row][1] ^ previous[row][1]) & (highResolution ? ~0ULL : 0);
+        if ((changed[changedCount][0] | changed[changedCount][1]) != 0)
+        {
+            rowMask |= 1ULL << row;
+            changedCount++;
+        }
+    }
+
+    if (highResolution != previousHighResolution)
+    {
+        needKeyframe = true;
+    }
+    if (!rowMask && !needKeyframe)
+    {
+        return;
+    }
+
+    bool keyframe = needKeyframe || ++framesSinceKeyframe >= keyframeInterval;
+
+    keyPayload.clear();
+    PutVarint(keyPayload, cycle - lastCycle);
+    keyPayload.push_back((soundOn ? SOUND_FLAG : 0) | (highResolution ? HIGH_RESOLUTION_FLAG : 0));
+    PutRuns(keyPayload, display, height, words);
+
+    if (!keyframe)
+    {
+        deltaPayload.clear();
+        PutVarint(deltaPayload, cycle - lastCycle);
+        for (unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            deltaPayload.push_back(static_cast<uint8_t>(rowMask >> shift));
+        }
+        PutRuns(deltaPayload, changed, changedCount, words);
+        keyframe = keyPayload.size() <= deltaPayload.size();
+    }
+
+    if (Emit(keyframe ? StreamPacket::Keyframe : StreamPacket::Delta, keyframe ? keyPayload : deltaPayload))
+    {
+        memcpy(previous, display, sizeof(previous));
+        previousHighResolution = highResolution;
+        lastCycle = cycle;
+        if (keyframe)
+        {
+            needKeyframe = false;
+            framesSinceKeyframe = 0;
+        }
+    }
+}
+
+void StreamEncoder::EncodeFrame(Frame const& frame)
+{
+    EncodeFrame(frame.display, frame.highResolution, frame.cycleCount);
+}
+
+/**
+ * @brief Encode the beeper turning on or off.
+ * 
+ * @param on whether the sound timer is now running
+ * @param cycle cycleCount of the edge
+ */
+void StreamEncoder::EncodeSound(bool on, uint64_t cycle)
+{
+    soundOn = on;
+    deltaPayload.clear();
+    PutVarint(deltaPayload, cycle - lastCycle);
+    deltaPayload.push_back(on ? 1 : 0);
+    if (Emit(StreamPacket::Sound, deltaPayload))
+    {
+        lastCycle = cycle;
+    }
+}
+
+/**
+ * @brief Frame a payload and write it to the ring.
+ * A dropped packet leaves the viewer out of sync, so the next frame is sent as a keyframe.
+ * 
+ * @return whether the packet fit
+ */
+bool StreamEncoder::Emit(StreamPacket type, std::vector<uint8_t> const& payload)
+{
+    packet.clear();
+    packet.push_back(static_cast<uint8_t>(type));
+    PutVarint(packet, payload.size());
+    packet.insert(packet.end(), payload.begin(), payload.end());
+
+    if (!ring.Write(packet.data(), packet.size()))
+    {
+        packetsDropped++;
+        needKeyframe = true;
+        return false;
+    }
+    bytesWritten += packet.size();
+    return true;
+}
+
+uint64_t StreamEncoder::BytesWritten() const
+{
+    return bytesWritten;
+}
+
+uint64_t StreamEncoder::PacketsDropped() const
+{
+    return packetsDropped;
+}
+
+/**
+ * @brief Apply every whole packet in bytes. Deltas before the first keyframe are skipped.
+ * 
+ * @param bytes stream data
+ * @param length number of bytes
+ * @return bytes consumed; the rest is the start of a packet still to arrive
+ */
+size_t StreamDecoder::Decode(uint8_t const* bytes, size_t length)
+{
+    uint8_t const* position = bytes;
+    uint8_t const* end = bytes + length;
+
+    while (position < end)
+    {
+        uint8_t const* cursor = position + 1;
+        uint64_t size;
+        if (!GetVarint(cursor, end, size) || size > static_cast<uint64_t>(end - cursor))
+        {
+            break;
+        }
+
+        uint8_t const* payload = cursor;
+        uint8_t const* payloadEnd = cursor + size;
+        StreamPacket type = static_cast<StreamPacket>(*position);
+        position = payloadEnd;
+
+        uint64_t elapsed;
+        if (!GetVarint(payload, payloadEnd, elapsed))
+        {
+            continue;
+        }
+        cycle += elapsed;
+
+        if (type == StreamPacket::Sound && payload < payloadEnd)
+        {
+            soundOn = *payload != 0;
+        } else if (type == StreamPacket::Keyframe && payload < payloadEnd)
+        {
+            uint8_t flags = *payload++;
+            soundOn = (flags & SOUND_FLAG) != 0;
+            highResolution = (flags & HIGH_RESOLUTION_FLAG) != 0;
+            memset(display, 0, sizeof(display));
+            synced = GetRuns(payload, payloadEnd, display, highResolution ? 64 : 32, highResolution ? 2 : 1);
+        } else if (type == StreamPacket::Delta && synced && payloadEnd - payload >= 8)
+        {
+            uint64_t rowMask = 0;
+            for (unsigned int i = 0; i < 8; i++)
+            {
+                rowMask |= static_cast<uint64_t>(payload[i]) << (i * 8);
+            }
+            uint64_t changed[ROWS][2];
+            unsigned int count = std::popcount(rowMask);
+            if (GetRuns(payload + 8, payloadEnd, changed, count, highResolution ? 2 : 1))
+            {
+                for (unsigned int i = 0; rowMask; i++, rowMask &= rowMask - 1)
+                {
+                    unsigned int row = std::countr_zero(rowMask);
+                    display[row][0] ^= changed[i][0];
+                    display[row][1] ^= changed[i][1];
+                }
+            }
+        }
+    }
+
+    return static_cast<size_t>(position - bytes);
+}
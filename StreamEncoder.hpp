@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Channels.hpp"
+#include <atomic>
+#include <vector>
+
+// Byte ring between the encoder thread and the thread sending the stream.
+// Writes are all or nothing, so a reader never sees half a packet.
+class StreamRing
+{
+public:
+    explicit StreamRing(size_t capacity = 1 << 16); //rounded up to a power of two
+
+    bool Write(uint8_t const* bytes, size_t length); //producer, false if it doesn't fit
+    size_t Read(uint8_t* bytes, size_t maxLength); //consumer, returns bytes read
+    size_t Capacity() const;
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; //next byte to read
+    alignas(64) std::atomic<size_t> tail{0}; //next byte to write
+};
+
+// Packets on the stream, each [type][varint payload length][payload]:
+//   KEYFRAME  varint cycles since the last packet, flags byte (bit 0 sound on, bit 1 128 * 64),
+//             runs of the whole screen
+//   DELTA     varint cycles since the last packet, 8 byte little endian mask of changed rows,
+//             runs of the changed rows XORed with the previous frame
+//   SOUND     varint cycles since the last packet, sound byte
+// Runs are varints alternating off, on, off... through the rows' pixels from the top left, 
+// 64 or 128 pixels per row as set by the last keyframe; the last run is left out since the total is known.
+enum class StreamPacket : uint8_t
+{
+    Keyframe = 1,
+    Delta = 2,
+    Sound = 3
+};
+
+// Encodes a machine's frames and beeper edges as a compact binary stream.
+// Frames are sent as deltas against the previous frame, or as keyframes when that is shorter,
+// every keyframeInterval frames so a viewer can join late, after a packet was dropped, 
+// and when the resolution changes.
+class StreamEncoder
+{
+public:
+    explicit StreamEncoder(StreamRing& ring, uint32_t keyframeInterval = 300);
+
+    template <typename Machine>
+    void Capture(Machine const& chip); //encodes the display if it changed and the beeper if it toggled
+    void EncodeFrame(uint64_t const display[64][2], bool highResolution, uint64_t cycle);
+    void EncodeFrame(Frame const& frame);
+    void EncodeSound(bool on, uint64_t cycle);
+
+    uint64_t BytesWritten() const;
+    uint64_t PacketsDropped() const; //packets that didn't fit in the ring
+
+private:
+    StreamRing& ring;
+    uint32_t keyframeInterval;
+    uint32_t framesSinceKeyframe = 0;
+    bool needKeyframe = true;
+    bool soundOn = false;
+    uint64_t lastCycle = 0;
+    uint64_t generation = ~0ULL;
+    uint64_t previous[64][2]{};
+    bool previousHighResolution = false;
+    uint64_t bytesWritten = 0;
+    uint64_t packetsDropped = 0;
+    std::vector<uint8_t> packet;
+    std::vector<uint8_t> keyPayload;
+    std::vector<uint8_t> deltaPayload;
+
+    bool Emit(StreamPacket type, std::vector<uint8_t> const& payload);
+};
+
+/**
+ * @brief Encode whatever changed since the last capture, typically once per frame.
+ * 
+ * @param chip machine to capture, any Chip8Core variant
+ */
+template <typename Machine>
+void StreamEncoder::Capture(Machine const& chip)
+{
+    if ((chip.soundTimer > 0) != soundOn)
+    {
+        EncodeSound(chip.soundTimer > 0, chip.cycleCount);
+    }
+    if (chip.DisplayGeneration() != generation)
+    {
+        generation = chip.DisplayGeneration();
+        uint64_t rows[64][2]{};
+        CopyDisplay(chip, rows);
+        EncodeFrame(rows, chip.highResolution, chip.cycleCount);
+    }
+}
+
+// Rebuilds the screen and beeper state from a stream, for tests and native viewers.
+class StreamDecoder
+{
+public:
+    size_t Decode(uint8_t const* bytes, size_t length); //consumes whole packets, returns bytes used
+
+    uint64_t display[64][2]{};
+    bool highResolution = false;
+    bool soundOn = false;
+    uint64_t cycle = 0;
+    bool synced = false; //a keyframe has been seen
+};
@@ -0,0 +1,365 @@
+/**
+ * @file TestRunner.cpp
+ * @brief Conformance runner: executes a manifest of ROM tests in parallel and checks display hashes.
+ * 
+ * Usage: testrunner [-j threads] [--print] manifest [manifest ...]
+ * Every test boots its ROM, runs it for its instruction budget while feeding in its input script,
+ * and compares a hash of the packed display with the expected value at each checkpoint.
+ * Tests run across the farm's WorkStealingPool; the exit status is 1 if any test fails.
+ * With --print the hashes actually seen are written out as expect lines, to fill in a new manifest.
+ * 
+ * Manifest lines, # starts a comment and paths are relative to the manifest:
+ *   test <name> <rom> <instructions> [chip8|cosmac|schip|xochip]    starts a test, chip8 by default
+ *   seed <n>                                                        RND seed, 0 by default
+ *   timers <instructions>                                           tick the timers this often, never by default
+ *   press <instruction> <key>                                       key down once the count is reached
+ *   release <instruction> <key>                                     key up once the count is reached
+ *   expect <instruction> <hash>                                     display hash in hex at that count
+ * 
+ */
+
+#include "Chip8.hpp"
+#include "Chip8Farm.hpp"
+#include "RomRegistry.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+enum class Variant
+{
+    Chip8,
+    Cosmac,
+    SuperChip,
+    XoChip
+};
+
+// Something that happens at an instruction count during a test
+struct TestEvent
+{
+    uint64_t cycle;
+    enum { Press, Release, Expect } type;
+    uint8_t key;
+    uint64_t hash;
+};
+
+struct TestCase
+{
+    std::string name;
+    std::string romPath;
+    RomHandle rom;
+    Variant variant = Variant::Chip8;
+    uint64_t instructions = 0;
+    uint64_t seed = 0;
+    uint64_t timerInterval = 0; //0 for timers that never tick
+    std::vector<TestEvent> events; //sorted by cycle
+    char const* manifest;
+    unsigned int line;
+};
+
+struct TestResult
+{
+    bool passed = true;
+    std::string message; //first failure
+    std::vector<std::pair<uint64_t, uint64_t>> hashes; //cycle and hash at every checkpoint
+};
+
+/**
+ * @brief FNV-1a of the packed display rows, taken a byte at a time from each word's lowest bits
+ * so the hash doesn't depend on the host's byte order. The resolution flag is mixed in last.
+ * 
+ * @param chip machine to hash, any Chip8Core variant
+ * @return the hash
+ */
+template <typename Machine>
+uint64_t DisplayHash(Machine const& chip)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (auto const& row : chip.display)
+    {
+        for (uint64_t word : row)
+        {
+            for (unsigned int shift = 0; shift < 64; shift += 8)
+            {
+                hash = (hash ^ ((word >> shift) & 0xFFU)) * FNV_PRIME;
+            }
+        }
+    }
+    return (hash ^ (chip.highResolution ? 1U : 0U)) * FNV_PRIME;
+}
+
+/**
+ * @brief Execute until the machine reaches an instruction count.
+ * 
+ * @param chip machine to run
+ * @param cycle cycleCount to stop at
+ */
+template <typename Machine>
+void RunTo(Machine& chip, uint64_t cycle)
+{
+    while (chip.cycleCount < cycle)
+    {
+        uint64_t remaining = cycle - chip.cycleCount;
+        chip.Run(static_cast<uint32_t>(std::min<uint64_t>(remaining, UINT32_MAX)));
+    }
+}
+
+/**
+ * @brief Run one test on a fresh machine of its variant.
+ * Inputs at an instruction count apply before the checkpoint at the same count.
+ * 
+ * @param test what to run
+ * @param result checkpoint hashes and the first failure
+ */
+template <typename Machine>
+void RunTest(TestCase const& test, TestResult& result)
+{
+    Machine chip(test.seed);
+    chip.executionMode = ExecutionMode::Threaded;
+    chip.LoadROM(*test.rom);
+
+    uint64_t nextTick = test.timerInterval ? test.timerInterval : UINT64_MAX;
+    size_t next = 0;
+    for (;;)
+    {
+        uint64_t eventCycle = next < test.events.size() ? test.events[next].cycle : UINT64_MAX;
+        uint64_t stop = std::min({eventCycle, nextTick, test.instructions});
+        RunTo(chip, stop);
+
+        for (; next < test.events.size() && test.events[next].cycle == stop; next++)
+        {
+            TestEvent const& event = test.events[next];
+            if (event.type != TestEvent::Expect)
+            {
+                chip.keypad[event.key] = event.type == TestEvent::Press ? 1 : 0;
+                continue;
+            }
+
+            uint64_t hash = DisplayHash(chip);
+            result.hashes.emplace_back(stop, hash);
+            if (hash != event.hash && result.passed)
+            {
+                char message[128];
+                snprintf(message, sizeof(message), "at %llu expected %016llx got %016llx",
+                        static_cast<unsigned long long>(stop), static_cast<unsigned long long>(event.hash),
+                        static_cast<unsigned long long>(hash));
+                result.passed = false;
+                result.message = message;
+            }
+        }
+
+        if (stop == test.instructions)
+        {
+            break;
+        }
+        if (stop == nextTick)
+        {
+            chip.TickTimers();
+            nextTick += test.timerInterval;
+        }
+    }
+}
+
+/**
+ * @brief Parse a variant name from a test line.
+ * 
+ * @return false if the name is unknown
+ */
+bool ParseVariant(std::string const& name, Variant& variant)
+{
+    const std::pair<char const*, Variant> names[] =
+    {
+        {"chip8", Variant::Chip8},
+        {"cosmac", Variant::Cosmac},
+        {"schip", Variant::SuperChip},
+        {"xochip", Variant::XoChip}
+    };
+    for (auto const& [text, value] : names)
+    {
+        if (name == text)
+        {
+            variant = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Read the tests from a manifest, loading their ROMs through the registry.
+ * 
+ * @param filename manifest to read
+ * @param registry shares ROMs used by several tests
+ * @param tests receives the tests
+ * @return false if the manifest can't be read or has a bad line, which is reported
+ */
+bool ReadManifest(char const* filename, RomRegistry& registry, std::vector<TestCase>& tests)
+{
+    std::ifstream in(filename);
+    if (!in)
+    {
+        fprintf(stderr, "%s: can't read\n", filename);
+        return false;
+    }
+
+    std::string directory = filename;
+    size_t slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? "" : directory.substr(0, slash + 1);
+
+    size_t first = tests.size();
+    std::string text;
+    for (unsigned int line = 1; std::getline(in, text); line++)
+    {
+        std::istringstream words(text.substr(0, text.find('#')));
+        std::string keyword;
+        if (!(words >> keyword))
+        {
+            continue;
+        }
+
+        bool ok = true;
+        if (keyword == "test")
+        {
+            TestCase test;
+            std::string variant = "chip8";
+            ok = static_cast<bool>(words >> test.name >> test.romPath >> test.instructions);
+            words >> variant;
+            ok = ok && ParseVariant(variant, test.variant);
+            test.manifest = filename;
+            test.line = line;
+            if (ok)
+            {
+                if (test.romPath.empty() || (test.romPath[0] != '/' && test.romPath.find(':') == std::string::npos))
+                {
+                    test.romPath = directory + test.romPath;
+                }
+                test.rom = registry.Load(test.romPath.c_str());
+                if (!test.rom)
+                {
+                    fprintf(stderr, "%s:%u: can't load %s\n", filename, line, test.romPath.c_str());
+                    return false;
+                }
+                tests.push_back(std::move(test));
+            }
+        } else if (tests.size() == first)
+        {
+            ok = false;
+        } else if (keyword == "seed")
+        {
+            ok = static_cast<bool>(words >> tests.back().seed);
+        } else if (keyword == "timers")
+        {
+            ok = static_cast<bool>(words >> tests.back().timerInterval);
+        } else if (keyword == "press" || keyword == "release" || keyword == "expect")
+        {
+            TestEvent event{};
+            event.type = keyword == "press" ? TestEvent::Press : keyword == "release" ? TestEvent::Release : TestEvent::Expect;
+            unsigned int key = 0;
+            ok = static_cast<bool>(words >> event.cycle);
+            if (ok && event.type == TestEvent::Expect)
+            {
+                ok = static_cast<bool>(words >> std::hex >> event.hash);
+            } else if (ok)
+            {
+                ok = static_cast<bool>(words >> std::hex >> key) && key < 16;
+                event.key = static_cast<uint8_t>(key);
+            }
+            tests.back().events.push_back(event);
+        } else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            fprintf(stderr, "%s:%u: can't parse \"%s\"\n", filename, line, text.c_str());
+            return false;
+        }
+    }
+
+    for (size_t i = first; i < tests.size(); i++)
+    {
+        std::vector<TestEvent>& events = tests[i].events;
+        std::stable_sort(events.begin(), events.end(), [](TestEvent const& a, TestEvent const& b) { return a.cycle < b.cycle; });
+        if (!events.empty() && events.back().cycle > tests[i].instructions)
+        {
+            fprintf(stderr, "%s:%u: %s has events after its last instruction\n", filename, tests[i].line, tests[i].name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    bool print = false;
+    std::vector<TestCase> tests;
+    RomRegistry registry;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threads = static_cast<unsigned int>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--print") == 0)
+        {
+            print = true;
+        } else if (!ReadManifest(argv[i], registry, tests))
+        {
+            return 2;
+        }
+    }
+
+    if (tests.empty())
+    {
+        fprintf(stderr, "usage: %s [-j threads] [--print] manifest [manifest ...]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<TestResult> results(tests.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    WorkStealingPool pool(threads > 0 ? threads : 1);
+    pool.ParallelFor(tests.size(), [&tests, &results](size_t index)
+    {
+        switch (tests[index].variant)
+        {
+            case Variant::Chip8: RunTest<Chip8>(tests[index], results[index]); break;
+            case Variant::Cosmac: RunTest<CosmacChip8>(tests[index], results[index]); break;
+            case Variant::SuperChip: RunTest<SuperChip8>(tests[index], results[index]); break;
+            case Variant::XoChip: RunTest<XoChip8>(tests[index], results[index]); break;
+        }
+    });
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < tests.size(); i++)
+    {
+        if (print)
+        {
+            printf("# %s\n", tests[i].name.c_str());
+            for (auto const& [cycle, hash] : results[i].hashes)
+            {
+                printf("expect %llu %016llx\n", static_cast<unsigned long long>(cycle), static_cast<unsigned long long>(hash));
+            }
+        }
+        if (!results[i].passed)
+        {
+            failed++;
+            printf("FAIL %s (%s:%u) %s\n", tests[i].name.c_str(), tests[i].manifest, tests[i].line, results[i].message.c_str());
+        }
+    }
+
+    printf("%zu of %zu tests passed in %.3f s\n", tests.size() - failed, tests.size(), elapsed.count());
+    return failed ? 1 : 0;
+}